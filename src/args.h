@@ -1,66 +1,175 @@
-
-#include <iostream>
-#include <regex>
-#include <string>
-
-void help() {
-    std::cout << "Usage: MatchManager --flag=value" << R"(
-Required flags:
---engine1         path to engine1
---engine2         path to engine2
-
-Optional flags:
---time            milliseconds of movetime [100]
---threads         # of matches to run in parallel [1]
---fen_file        path to file with starting positions [lc01k.txt]
-)";
-    std::exit(1);
-}
-
-void verify_args(int argc, char *argv[]) {
-    for (int i = 1; i < argc; i++)
-    {
-        if (!(
-               std::regex_match(argv[i], std::regex("--engine[12]=.+"))
-            || std::regex_match(argv[i], std::regex("--time=[1-9]\\d*"))
-            || std::regex_match(argv[i], std::regex("--threads=[1-9]\\d*"))
-            || std::regex_match(argv[i], std::regex("--fen_file=.+"))
-        ))
-        {
-            std::cout << "Bad arg '" << argv[i] << "'" << std::endl;
-            help();
-        }
-    }
-}
-
-std::string get_with_default(const std::string& flag, int argc, char *argv[], std::string defval)
-{
-    std::string prefix = "--" + flag + "=";
-
-    for (int i = 1; i < argc; i++)
-    {
-        std::string arg = argv[i];
-
-        if (arg.find(prefix) == 0)
-        {
-            std::string val = arg.substr(prefix.length());
-            std::cout << "found flag " << flag << " = " << val << std::endl;
-
-            return val;
-        }
-    }
-
-    return defval;
-}
-
-std::string get_required(const std::string& flag, int argc, char* argv[])
-{
-    std::string val = get_with_default(flag, argc, argv, "");
-
-    if (val.empty()) {
-        std::cout << "Required flag " << flag << " was not found" << std::endl;
-        help();
-    }
-
-    return val;
+
+#include <iostream>
+#include <regex>
+#include <string>
+
+void help() {
+    std::cout << "Usage: MatchManager --flag=value" << R"(
+Required flags:
+--engine1         path to engine1
+--engine2         path to engine2
+
+Tournament flags (replace --engine1 and --engine2):
+--engines         comma separated engine paths, the first one is the gauntlet reference
+--tournament      roundrobin, gauntlet or swiss [roundrobin]
+--games           games per pairing, or per engine for swiss [2 x # of positions in fen_file]
+--engine_cache    # of warm engine processes kept per thread [4]
+--rating_interval print the rating table every # games, 0 to disable [1000]
+
+Benchmark flags:
+--bench           play --games games [1000] between --engine1 and --engine2 [mockengine.exe]
+                  and report the time MatchManager itself spends per move
+
+SPSA flags (replace --engine2):
+--spsa            file with one 'name start min max step rate' line per UCI spin option of --engine1 to tune
+                  by playing --games games [2000] in pairs against itself, on --threads threads
+
+Opening suite flags (replace --engine1 and --engine2):
+--openings_report write the --opening_history stats of every position in --fen_file to this CSV file
+--openings_prune  write the positions of --fen_file that are not always drawn, lopsided or decided
+                  at book exit to this file
+--openings_min_games
+                  # of games an opening needs before it is judged [4]
+
+Opening generation flags:
+--genbook         write --genbook_count unique openings to this file, from random playouts on --threads [all] threads
+--genbook_count   # of openings [100000]
+--genbook_plies   plies per playout, a number or a range [8-16]
+--genbook_seeds   file of FENs to play out from [start position]
+--genbook_weighted
+                  prefer captures and central pawn and minor piece moves to uniformly random ones
+
+Test suite flags:
+--epd             EPD file with bm or am operations to run --engines, or --engine1 and --engine2, on,
+                  each position with go movetime --time, on --threads [all] threads
+--epd_nodes       search each position with go nodes instead; --time + --grace is still the time limit [off]
+
+Verify flags:
+--verify          comma separated game logs, .pgn files, --datagen .bin files or directories of them
+                  to replay and check for illegal moves and wrong results, on --threads [all] threads
+
+Optional flags:
+--time            milliseconds of movetime [100]
+--threads         # of games to play in parallel, or auto to find the most the machine can take [1]
+--passes          # of times a match plays every position in --fen_file [--threads, 1 with --threads=auto]
+--max_overshoot   with --threads=auto, p99 milliseconds past --time above which fewer threads are used [5% of --time, at least 2]
+--fen_file        path to file with starting positions [lc01k.txt]
+--checkpoint      checkpoint file, rewritten periodically [logs\<engine1>_<engine2>_<time>.ckpt]
+--checkpoint_interval
+                  seconds between checkpoints [60]
+--resume          continue the run saved in the checkpoint file
+--results         write per engine results, timing and resource usage to this JSON file
+--datagen         directory to write packed training data to [off]
+--datagen_rotate  # of positions per training data file, rounded up to whole games [10000000]
+--grace           milliseconds past --time before a move is a time loss [1000]
+--engine_memory   per engine process memory limit in MB [off]
+--engine_cpu      per engine process CPU time limit in seconds [off]
+--metrics_port    serve live metrics in the Prometheus text format on http://127.0.0.1:<port>/metrics [off]
+--metrics_file    rewrite this file with the same metrics every 5 seconds [off]
+--low_latency     for --time of a few ms: large pipes, and every thread spins on its engines' output
+                  instead of sleeping, which keeps a core per thread busy
+--record          record everything written to and read from each engine to this directory [off]
+--replay          comma separated recordings or directories of them: no engine is started, every move
+                  is answered with the output recorded for the same position [off]
+--replay_speed    replay the recorded timing this many times faster, 0 for none [0]
+--coordinator     hand the games of this match out to workers connecting on this TCP port [off]
+--worker          play games for the coordinator at host:port with the local --engine1 and --engine2 [off]
+--opening_history game lengths per opening from earlier runs, longest are played first [logs\openings.txt]
+)";
+    std::exit(1);
+}
+
+void verify_args(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++)
+    {
+        if (!(
+               std::regex_match(argv[i], std::regex("--engine[12]=.+"))
+            || std::regex_match(argv[i], std::regex("--time=[1-9]\\d*"))
+            || std::regex_match(argv[i], std::regex("--threads=([1-9]\\d*|auto)"))
+            || std::regex_match(argv[i], std::regex("--passes=[1-9]\\d*"))
+            || std::regex_match(argv[i], std::regex("--max_overshoot=[1-9]\\d*"))
+            || std::regex_match(argv[i], std::regex("--fen_file=.+"))
+            || std::regex_match(argv[i], std::regex("--engines=[^,]+(,[^,]+)+"))
+            || std::regex_match(argv[i], std::regex("--tournament=(roundrobin|gauntlet|swiss)"))
+            || std::regex_match(argv[i], std::regex("--games=[1-9]\\d*"))
+            || std::regex_match(argv[i], std::regex("--engine_cache=([2-9]|[1-9]\\d+)"))
+            || std::regex_match(argv[i], std::regex("--rating_interval=\\d+"))
+            || std::regex_match(argv[i], std::regex("--checkpoint=.+"))
+            || std::regex_match(argv[i], std::regex("--checkpoint_interval=[1-9]\\d*"))
+            || std::regex_match(argv[i], std::regex("--resume"))
+            || std::regex_match(argv[i], std::regex("--bench"))
+            || std::regex_match(argv[i], std::regex("--verify=[^,]+(,[^,]+)*"))
+            || std::regex_match(argv[i], std::regex("--results=.+"))
+            || std::regex_match(argv[i], std::regex("--datagen=.+"))
+            || std::regex_match(argv[i], std::regex("--datagen_rotate=[1-9]\\d*"))
+            || std::regex_match(argv[i], std::regex("--grace=\\d+"))
+            || std::regex_match(argv[i], std::regex("--opening_history=.+"))
+            || std::regex_match(argv[i], std::regex("--engine_memory=[1-9]\\d*"))
+            || std::regex_match(argv[i], std::regex("--engine_cpu=[1-9]\\d*"))
+            || std::regex_match(argv[i], std::regex("--low_latency"))
+            || std::regex_match(argv[i], std::regex("--record=.+"))
+            || std::regex_match(argv[i], std::regex("--replay=.+"))
+            || std::regex_match(argv[i], std::regex("--replay_speed=\\d+(\\.\\d+)?"))
+            || std::regex_match(argv[i], std::regex("--metrics_port=[1-9]\\d*"))
+            || std::regex_match(argv[i], std::regex("--metrics_file=.+"))
+            || std::regex_match(argv[i], std::regex("--coordinator=[1-9]\\d*"))
+            || std::regex_match(argv[i], std::regex("--worker=.+:\\d+"))
+            || std::regex_match(argv[i], std::regex("--spsa=.+"))
+            || std::regex_match(argv[i], std::regex("--genbook=.+"))
+            || std::regex_match(argv[i], std::regex("--genbook_count=[1-9]\\d*"))
+            || std::regex_match(argv[i], std::regex("--genbook_plies=\\d+(-\\d+)?"))
+            || std::regex_match(argv[i], std::regex("--genbook_seeds=.+"))
+            || std::regex_match(argv[i], std::regex("--genbook_weighted"))
+            || std::regex_match(argv[i], std::regex("--epd=.+"))
+            || std::regex_match(argv[i], std::regex("--epd_nodes=[1-9]\\d*"))
+            || std::regex_match(argv[i], std::regex("--openings_report=.+"))
+            || std::regex_match(argv[i], std::regex("--openings_prune=.+"))
+            || std::regex_match(argv[i], std::regex("--openings_min_games=[1-9]\\d*"))
+        ))
+        {
+            std::cout << "Bad arg '" << argv[i] << "'" << std::endl;
+            help();
+        }
+    }
+}
+
+bool has_flag(const std::string& flag, int argc, char *argv[])
+{
+    for (int i = 1; i < argc; i++)
+        if (argv[i] == "--" + flag)
+            return true;
+
+    return false;
+}
+
+std::string get_with_default(const std::string& flag, int argc, char *argv[], std::string defval)
+{
+    std::string prefix = "--" + flag + "=";
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+
+        if (arg.find(prefix) == 0)
+        {
+            std::string val = arg.substr(prefix.length());
+            std::cout << "found flag " << flag << " = " << val << std::endl;
+
+            return val;
+        }
+    }
+
+    return defval;
+}
+
+std::string get_required(const std::string& flag, int argc, char* argv[])
+{
+    std::string val = get_with_default(flag, argc, argv, "");
+
+    if (val.empty()) {
+        std::cout << "Required flag " << flag << " was not found" << std::endl;
+        help();
+    }
+
+    return val;
 }
\ No newline at end of file
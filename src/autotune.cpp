@@ -0,0 +1,116 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define NOMINMAX
+
+#include "autotune.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <windows.h>
+
+#include "misc.h"
+
+namespace {
+
+constexpr int      IntervalSeconds = 5;    // shortest time at one level before deciding
+constexpr uint64_t MinMoves        = 200;  // fewest moves to judge the p99 overshoot by
+constexpr int      HoldIntervals   = 12;   // good intervals before a failed level is retried
+constexpr double   MaxCpuBusy      = 0.95;
+
+uint64_t to_ticks(const FILETIME& ft) {
+    return (uint64_t(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+}
+
+}
+
+Autotuner::Autotuner(Control& control, int max_threads, int64_t max_overshoot_us)
+    : m_control(control), m_max(max_threads), m_limit(max_overshoot_us), last_idle(0), last_total(0), quit(false)
+{
+    m_control.set_threads(std::max(1, m_max / 4));
+
+    printf("%s Autotune: %d of %d threads, p99 overshoot limit %.1f ms\n", time_().c_str(), m_control.active(), m_max, m_limit / 1000.0);
+
+    cpu_busy();
+    thread = std::thread(&Autotuner::loop, this);
+}
+
+Autotuner::~Autotuner()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        quit = true;
+    }
+
+    cv.notify_one();
+    thread.join();
+}
+
+// Fraction of the time since the last call that the CPUs were busy, with anything on the machine
+double Autotuner::cpu_busy()
+{
+    FILETIME idle, kernel, user;
+
+    if (!GetSystemTimes(&idle, &kernel, &user))
+        return 0;
+
+    uint64_t i = to_ticks(idle), total = to_ticks(kernel) + to_ticks(user);  // kernel time includes idle time
+    double busy = total > last_total ? 1.0 - double(i - last_idle) / (total - last_total) : 0;
+
+    last_idle  = i;
+    last_total = total;
+
+    return busy;
+}
+
+void Autotuner::loop()
+{
+    using Clock = std::chrono::steady_clock;
+
+    std::unique_lock<std::mutex> lock(mtx);
+
+    Histogram window;
+    Clock::time_point since = Clock::now();
+    int ceiling = m_max + 1, held = 0;
+
+    while (!cv.wait_for(lock, std::chrono::seconds(1), [&] { return quit; }))
+    {
+        window.merge(m_control.take_overshoot());
+
+        if (Clock::now() - since < std::chrono::seconds(IntervalSeconds) || window.count() < MinMoves)
+            continue;
+
+        int    active = m_control.active(), next = active;
+        double p99    = window.percentile(99) / 1000.0;
+        double busy   = cpu_busy();
+
+        if (window.percentile(99) > m_limit)
+        {
+            ceiling = active;
+            held = 0;
+            next = std::max(1, active - std::max(1, active / 4));
+        }
+        else
+        {
+            if (++held >= HoldIntervals)
+            {
+                ceiling = m_max + 1;
+                held = 0;
+            }
+
+            if (busy < MaxCpuBusy)
+                next = std::min({ m_max, ceiling - 1, active + std::max(1, active / 4) });
+        }
+
+        if (next != active)
+        {
+            m_control.set_threads(next);
+
+            printf("%s Autotune: %d -> %d threads, p99 overshoot %.1f ms, cpu %.0f%% busy\n",
+                   time_().c_str(), active, next, p99, busy * 100);
+        }
+
+        window.clear();
+        m_control.take_overshoot();
+        since = Clock::now();
+    }
+}
@@ -0,0 +1,39 @@
+
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "control.h"
+
+// --threads=auto: starts with a quarter of the logical CPUs active and adds threads while
+// the p99 overshoot of recent moves stays under the limit and the machine has idle CPU.
+// When overshoot exceeds the limit it backs off by a quarter and does not try that level
+// again until the lower one has held for a while
+class Autotuner
+{
+public:
+    Autotuner(Control& control, int max_threads, int64_t max_overshoot_us);
+   ~Autotuner();
+
+private:
+    void   loop();
+    double cpu_busy();
+
+    Control& m_control;
+    int      m_max;
+    int64_t  m_limit;
+
+    uint64_t last_idle;
+    uint64_t last_total;
+
+    std::mutex              mtx;
+    std::condition_variable cv;
+    bool                    quit;
+    std::thread             thread;
+};
+
+#endif
@@ -0,0 +1,81 @@
+
+#include "bench.h"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "openings.h"
+
+void run_bench(const std::string& path_1, const std::string& path_2, int games, int threads, const std::string& fen_file, Control *control)
+{
+    std::vector<std::string> fens = load_openings(fen_file, std::thread::hardware_concurrency());
+
+    if (fens.empty())
+        fens.push_back("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+
+    std::atomic<int>      next   = 0;
+    std::atomic<uint64_t> played = 0, moves = 0;
+    std::mutex            mtx;
+    GameTimings           total;
+
+    auto start = std::chrono::steady_clock::now();
+
+    control->set_stats([&]() {
+        printf("%llu games, %llu moves in %.2f s\n", (unsigned long long)played, (unsigned long long)moves,
+               std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    });
+
+    std::vector<std::thread> thread_pool;
+
+    for (int id = 0; id < threads; id++)
+        thread_pool.emplace_back([&, id]() {
+            Engine e1(path_1, 1, id), e2(path_2, 1, id);
+
+            e1.handshake();
+            e2.handshake();
+
+            std::ofstream log("logs\\bench_id" + std::to_string(id) + ".txt");
+            GameTimings timings;
+
+            for (int g; control->next_game(id) && (g = next++) < games;)
+            {
+                GameResult r = g & 1 ? play_game(e2, e1, fens[g % fens.size()], control, log, nullptr, &timings)
+                                     : play_game(e1, e2, fens[g % fens.size()], control, log, nullptr, &timings);
+
+                log << "\n" << std::endl;
+
+                if (r.aborted())
+                    break;
+
+                if (r.failed)
+                {
+                    std::cout << "Bench " << id << ": Engine error" << std::endl;
+                    break;
+                }
+
+                played++;
+                moves += r.plies;
+            }
+
+            std::lock_guard<std::mutex> lock(mtx);
+            total.merge(timings);
+        });
+
+    for (std::thread& thread : thread_pool)
+        thread.join();
+
+    control->set_stats(nullptr);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("\n%llu games, %llu moves in %.2f s with %d threads\n", (unsigned long long)played, (unsigned long long)moves, seconds, threads);
+    printf("%.1f games/s, %.0f moves/s\n\n", played / seconds, moves / seconds);
+
+    total.go_to_bestmove.print("go -> bestmove", "us");
+    total.bestmove_to_validated.print("bestmove -> validated", "us");
+    total.validated_to_go.print("validated -> next go", "us");
+}
@@ -0,0 +1,11 @@
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <string>
+
+#include "game.h"
+
+void run_bench(const std::string& path_1, const std::string& path_2, int games, int threads, const std::string& fen_file, Control *control);
+
+#endif
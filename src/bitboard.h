@@ -1,222 +1,305 @@
-
-#ifndef BITBOARD_H
-#define BITBOARD_H
-
-#include <cmath>
-#include <immintrin.h>
-#include <string>
-
-#include "types.h"
-
-#define pext(b, m) _pext_u64(b, m)
-#define popcount(b) _mm_popcnt_u64(b)
-#define lsb(b) _tzcnt_u64(b)
-
-namespace Bitboards { void init(); }
-
-inline Bitboard DoubleCheck[SQUARE_NB];
-inline Bitboard KnightAttacks[SQUARE_NB];
-inline Bitboard KingAttacks[SQUARE_NB];
-inline Bitboard PawnAttacks[COLOR_NB][SQUARE_NB];
-inline Bitboard CheckRay[SQUARE_NB][SQUARE_NB];
-inline Bitboard AlignMask[SQUARE_NB][SQUARE_NB];
-inline Bitboard MainDiag[SQUARE_NB];
-inline Bitboard AntiDiag[SQUARE_NB];
-inline Bitboard FileBB[SQUARE_NB];
-inline uint8_t SquareDistance[SQUARE_NB][SQUARE_NB];
-inline uint8_t castle_masks[COLOR_NB][1 << 5];
-
-constexpr Bitboard ALL_SQUARES = 0xffffffffffffffffull;
-constexpr Bitboard FILE_A = 0x8080808080808080ull;
-constexpr Bitboard FILE_B = FILE_A >> 1;
-constexpr Bitboard FILE_C = FILE_A >> 2;
-constexpr Bitboard FILE_D = FILE_A >> 3;
-constexpr Bitboard FILE_E = FILE_A >> 4;
-constexpr Bitboard FILE_F = FILE_A >> 5;
-constexpr Bitboard FILE_G = FILE_A >> 6;
-constexpr Bitboard FILE_H = FILE_A >> 7;
-constexpr Bitboard NOT_FILE_A = ~FILE_A;
-constexpr Bitboard NOT_FILE_H = ~FILE_H;
-
-constexpr Bitboard RANK_1 = 0xffull;
-constexpr Bitboard RANK_2 = RANK_1 << 8;
-constexpr Bitboard RANK_3 = RANK_1 << 16;
-constexpr Bitboard RANK_4 = RANK_1 << 24;
-constexpr Bitboard RANK_5 = RANK_1 << 32;
-constexpr Bitboard RANK_6 = RANK_1 << 40;
-constexpr Bitboard RANK_7 = RANK_1 << 48;
-constexpr Bitboard RANK_8 = RANK_1 << 56;
-
-template<Direction D>
-constexpr Bitboard shift_unsafe(Bitboard bb)
-{
-    if constexpr (D == NORTH)       return  bb << 8;
-    if constexpr (D == NORTH_EAST)  return  bb << 7;
-    if constexpr (D == EAST)        return  bb >> 1;
-    if constexpr (D == SOUTH_EAST)  return  bb >> 9;
-    if constexpr (D == SOUTH)       return  bb >> 8;
-    if constexpr (D == SOUTH_WEST)  return  bb >> 7;
-    if constexpr (D == WEST)        return  bb << 1;
-    if constexpr (D == NORTH_WEST)  return  bb << 9;
-    if constexpr (D == NORTH+NORTH) return  bb << 16;
-    if constexpr (D == SOUTH+SOUTH) return  bb >> 16;
-}
-
-template<Direction D>
-constexpr Bitboard shift(Bitboard bb)
-{
-    if constexpr (D == NORTH)       return  bb << 8;
-    if constexpr (D == NORTH_EAST)  return (bb & NOT_FILE_H) << 7;
-    if constexpr (D == EAST)        return  bb >> 1;
-    if constexpr (D == SOUTH_EAST)  return (bb & NOT_FILE_H) >> 9;
-    if constexpr (D == SOUTH)       return  bb >> 8;
-    if constexpr (D == SOUTH_WEST)  return (bb & NOT_FILE_A) >> 7;
-    if constexpr (D == WEST)        return  bb << 1;
-    if constexpr (D == NORTH_WEST)  return (bb & NOT_FILE_A) << 9;
-    if constexpr (D == NORTH+NORTH) return  bb << 16;
-    if constexpr (D == SOUTH+SOUTH) return  bb >> 16;
-}
-
-inline Bitboard align_mask(Square ksq, Square pinned) {
-    return AlignMask[ksq][pinned];
-}
-
-inline Bitboard main_diag(Square s) {
-    return MainDiag[s];
-}
-
-inline Bitboard anti_diag(Square s) {
-    return AntiDiag[s];
-}
-
-inline Bitboard file_bb(Square s) {
-    return FileBB[s];
-}
-
-inline Bitboard double_check(Square ksq) {
-    return DoubleCheck[ksq];
-}
-
-inline Bitboard check_ray(Square ksq, Square checker) {
-    return CheckRay[ksq][checker];
-}
-
-constexpr Bitboard square_bb(Square s) {
-    return 1ull << s;
-}
-
-template<typename... squares>
-inline constexpr Bitboard square_bb(Square sq, squares... sqs) {
-    return square_bb(sq) | square_bb(sqs...);
-}
-
-inline Bitboard rank_bb(Square s) {
-    return RANK_1 << 8 * (s / 8);
-}
-
-inline std::string to_string(Bitboard b)
-{
-    std::string l = "+---+---+---+---+---+---+---+---+\n", s = l;
-
-    for (Bitboard bit = square_bb(A8); bit; bit >>= 1)
-    {
-        s += (bit & b) ? "| @ " : "|   ";
-
-        if (bit & FILE_H)
-            s += "|\n" + l;
-    }
-
-    return s + "\n";
-}
-
-inline Bitboard mask(Square s, Direction d)
-{
-    switch (d) 
-    {
-        case NORTH_EAST: return mask(s, NORTH) & mask(s, EAST);
-        case SOUTH_EAST: return mask(s, SOUTH) & mask(s, EAST);
-        case SOUTH_WEST: return mask(s, SOUTH) & mask(s, WEST);
-        case NORTH_WEST: return mask(s, NORTH) & mask(s, WEST);
-    }
-
-    if (d == NORTH || d == SOUTH)
-    {
-        Bitboard m = 0;
-
-        while (is_ok(s += d))
-            m |= rank_bb(s);
-
-        return m;
-    }
-    else
-    {
-        Bitboard r = rank_bb(s), m = 0;
-
-        while (square_bb(s += d) & r)
-            m |= FILE_H << s % 8;
-
-        return m;
-    }
-}
-
-inline void clear_lsb(Bitboard& b) {
-    b = _blsr_u64(b);
-}
-
-inline uint64_t more_than_one(Bitboard b) {
-    return _blsr_u64(b);
-}
-
-inline Bitboard knight_attacks(Square sq) {
-    return KnightAttacks[sq];
-}
-
-Bitboard attacks_bb(PieceType pt, Square sq, Bitboard occupied);
-
-inline Bitboard xray_bb(PieceType pt, Square sq, Bitboard occupied) {
-    return attacks_bb(pt, sq, occupied ^ attacks_bb(pt, sq, occupied) & occupied);
-}
-
-inline Bitboard king_attacks(Square sq) {
-    return KingAttacks[sq];
-}
-
-template<Color C>
-constexpr Bitboard pawn_attacks(Square sq) {
-    return PawnAttacks[C][sq];
-}
-
-template<Color C>
-constexpr Bitboard pawn_attacks(Bitboard pawns)
-{
-    if constexpr (C == WHITE) return shift<NORTH_EAST>(pawns) | shift<NORTH_WEST>(pawns);
-    else                      return shift<SOUTH_WEST>(pawns) | shift<SOUTH_EAST>(pawns);
-}
-
-inline void toggle_square(Bitboard& b, Square s) {
-    b ^= 1ull << s;
-}
-
-inline Bitboard generate_occupancy(Bitboard mask, int permutation) {
-    return _pdep_u64(permutation, mask);
-}
-
-inline int square_distance(Square a, Square b) {
-    return SquareDistance[a][b];
-}
-
-inline int file_distance(Square a, Square b) {
-    return std::abs((a % 8) - (b % 8));
-}
-
-inline int rank_distance(Square a, Square b) {
-    return std::abs((a / 8) - (b / 8));
-}
-
-inline Bitboard safe_step(Square s, int step)
-{
-    Square to = s + step;
-    return (is_ok(to) && square_distance(s, to) <= 2) ? square_bb(to) : 0;
-}
-
+
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <immintrin.h>
+#include <string>
+
+#include "types.h"
+
+#define pext(b, m) _pext_u64(b, m)
+#define popcount(b) _mm_popcnt_u64(b)
+#define lsb(b) _tzcnt_u64(b)
+
+constexpr Bitboard ALL_SQUARES = 0xffffffffffffffffull;
+constexpr Bitboard FILE_A = 0x8080808080808080ull;
+constexpr Bitboard FILE_B = FILE_A >> 1;
+constexpr Bitboard FILE_C = FILE_A >> 2;
+constexpr Bitboard FILE_D = FILE_A >> 3;
+constexpr Bitboard FILE_E = FILE_A >> 4;
+constexpr Bitboard FILE_F = FILE_A >> 5;
+constexpr Bitboard FILE_G = FILE_A >> 6;
+constexpr Bitboard FILE_H = FILE_A >> 7;
+constexpr Bitboard NOT_FILE_A = ~FILE_A;
+constexpr Bitboard NOT_FILE_H = ~FILE_H;
+
+constexpr Bitboard RANK_1 = 0xffull;
+constexpr Bitboard RANK_2 = RANK_1 << 8;
+constexpr Bitboard RANK_3 = RANK_1 << 16;
+constexpr Bitboard RANK_4 = RANK_1 << 24;
+constexpr Bitboard RANK_5 = RANK_1 << 32;
+constexpr Bitboard RANK_6 = RANK_1 << 40;
+constexpr Bitboard RANK_7 = RANK_1 << 48;
+constexpr Bitboard RANK_8 = RANK_1 << 56;
+
+template<Direction D>
+constexpr Bitboard shift_unsafe(Bitboard bb)
+{
+    if constexpr (D == NORTH)       return  bb << 8;
+    if constexpr (D == NORTH_EAST)  return  bb << 7;
+    if constexpr (D == EAST)        return  bb >> 1;
+    if constexpr (D == SOUTH_EAST)  return  bb >> 9;
+    if constexpr (D == SOUTH)       return  bb >> 8;
+    if constexpr (D == SOUTH_WEST)  return  bb >> 7;
+    if constexpr (D == WEST)        return  bb << 1;
+    if constexpr (D == NORTH_WEST)  return  bb << 9;
+    if constexpr (D == NORTH+NORTH) return  bb << 16;
+    if constexpr (D == SOUTH+SOUTH) return  bb >> 16;
+}
+
+template<Direction D>
+constexpr Bitboard shift(Bitboard bb)
+{
+    if constexpr (D == NORTH)       return  bb << 8;
+    if constexpr (D == NORTH_EAST)  return (bb & NOT_FILE_H) << 7;
+    if constexpr (D == EAST)        return  bb >> 1;
+    if constexpr (D == SOUTH_EAST)  return (bb & NOT_FILE_H) >> 9;
+    if constexpr (D == SOUTH)       return  bb >> 8;
+    if constexpr (D == SOUTH_WEST)  return (bb & NOT_FILE_A) >> 7;
+    if constexpr (D == WEST)        return  bb << 1;
+    if constexpr (D == NORTH_WEST)  return (bb & NOT_FILE_A) << 9;
+    if constexpr (D == NORTH+NORTH) return  bb << 16;
+    if constexpr (D == SOUTH+SOUTH) return  bb >> 16;
+}
+
+constexpr Bitboard square_bb(Square s) {
+    return 1ull << s;
+}
+
+template<typename... squares>
+inline constexpr Bitboard square_bb(Square sq, squares... sqs) {
+    return square_bb(sq) | square_bb(sqs...);
+}
+
+template<Color C>
+constexpr Bitboard pawn_attacks(Bitboard pawns)
+{
+    if constexpr (C == WHITE) return shift<NORTH_EAST>(pawns) | shift<NORTH_WEST>(pawns);
+    else                      return shift<SOUTH_WEST>(pawns) | shift<SOUTH_EAST>(pawns);
+}
+
+// Attack and geometry tables, generated at compile time into read-only data
+
+namespace Bitboards {
+
+constexpr int distance(Square a, Square b)
+{
+    int f = a % 8 - b % 8, r = a / 8 - b / 8;
+    return std::max(f < 0 ? -f : f, r < 0 ? -r : r);
+}
+
+constexpr Bitboard step(Square s, int d)
+{
+    int to = s + d;
+    return to >= H1 && to <= A8 && distance(s, to) <= 2 ? square_bb(to) : 0;
+}
+
+// Squares attacked from s along d, up to and including the first occupied one
+constexpr Bitboard ray(Square s, int d, Bitboard occupied = 0)
+{
+    Bitboard r = 0;
+
+    for (Bitboard b; (b = step(s, d)); s += d)
+        if ((r |= b) & occupied & b)
+            break;
+
+    return r;
+}
+
+constexpr Bitboard sliding_attacks(PieceType pt, Square sq, Bitboard occupied)
+{
+    return pt == ROOK ? ray(sq, NORTH, occupied)      | ray(sq, EAST, occupied)      | ray(sq, SOUTH, occupied)      | ray(sq, WEST, occupied)
+                      : ray(sq, NORTH_EAST, occupied) | ray(sq, SOUTH_EAST, occupied) | ray(sq, SOUTH_WEST, occupied) | ray(sq, NORTH_WEST, occupied);
+}
+
+template<typename T, typename F>
+constexpr std::array<T, SQUARE_NB> by_square(F f)
+{
+    std::array<T, SQUARE_NB> table{};
+
+    for (int s = H1; s <= A8; s++)
+        table[s] = f(Square(s));
+
+    return table;
+}
+
+template<typename T, typename F>
+constexpr std::array<std::array<T, SQUARE_NB>, SQUARE_NB> by_square_pair(F f)
+{
+    std::array<std::array<T, SQUARE_NB>, SQUARE_NB> table{};
+
+    for (int s1 = H1; s1 <= A8; s1++)
+        for (int s2 = H1; s2 <= A8; s2++)
+            table[s1][s2] = f(Square(s1), Square(s2));
+
+    return table;
+}
+
+// For aligned squares, the direction from s1 towards s2, otherwise 0
+constexpr int direction(Square s1, Square s2)
+{
+    for (int d : { NORTH, NORTH_EAST, EAST, SOUTH_EAST, SOUTH, SOUTH_WEST, WEST, NORTH_WEST })
+        if (ray(s1, d) & square_bb(s2))
+            return d;
+
+    return 0;
+}
+
+}
+
+constexpr auto FileBB = Bitboards::by_square<Bitboard>([](Square s) { return FILE_H << s % 8; });
+
+constexpr auto MainDiag = Bitboards::by_square<Bitboard>([](Square s) {
+    return Bitboards::ray(s, NORTH_WEST) | Bitboards::ray(s, SOUTH_EAST) | square_bb(s);
+});
+
+constexpr auto AntiDiag = Bitboards::by_square<Bitboard>([](Square s) {
+    return Bitboards::ray(s, NORTH_EAST) | Bitboards::ray(s, SOUTH_WEST) | square_bb(s);
+});
+
+constexpr auto KingAttacks = Bitboards::by_square<Bitboard>([](Square s) {
+    Bitboard b = 0;
+
+    for (int d : { NORTH, NORTH_EAST, EAST, SOUTH_EAST, SOUTH, SOUTH_WEST, WEST, NORTH_WEST })
+        b |= Bitboards::step(s, d);
+
+    return b;
+});
+
+constexpr auto KnightAttacks = Bitboards::by_square<Bitboard>([](Square s) {
+    Bitboard b = 0;
+
+    for (int d : { NORTH+NORTH_EAST, NORTH_EAST+EAST, SOUTH_EAST+EAST, SOUTH+SOUTH_EAST,
+                   SOUTH+SOUTH_WEST, SOUTH_WEST+WEST, NORTH_WEST+WEST, NORTH+NORTH_WEST })
+        b |= Bitboards::step(s, d);
+
+    return b;
+});
+
+constexpr auto DoubleCheck = Bitboards::by_square<Bitboard>([](Square s) { return KingAttacks[s] | KnightAttacks[s]; });
+
+constexpr std::array<std::array<Bitboard, SQUARE_NB>, COLOR_NB> PawnAttacks = {
+    Bitboards::by_square<Bitboard>([](Square s) { return pawn_attacks<WHITE>(square_bb(s)); }),
+    Bitboards::by_square<Bitboard>([](Square s) { return pawn_attacks<BLACK>(square_bb(s)); })
+};
+
+// Squares between ksq and the checker, plus the checker
+constexpr auto CheckRay = Bitboards::by_square_pair<Bitboard>([](Square s1, Square s2) {
+    int d = Bitboards::direction(s1, s2);
+    return d ? Bitboards::ray(s1, d, square_bb(s2)) & ~Bitboards::ray(s2, d) : Bitboard(0);
+});
+
+// The whole line through two aligned squares
+constexpr auto AlignMask = Bitboards::by_square_pair<Bitboard>([](Square s1, Square s2) {
+    int d = Bitboards::direction(s1, s2);
+    return d ? Bitboards::ray(s1, d) | Bitboards::ray(s1, -d) | square_bb(s1) : Bitboard(0);
+});
+
+constexpr auto SquareDistance = Bitboards::by_square_pair<uint8_t>([](Square s1, Square s2) {
+    return uint8_t(Bitboards::distance(s1, s2));
+});
+
+// Castling rights (KQkq = 8 4 2 1) that survive a move from or to the square
+constexpr auto CastlingMask = Bitboards::by_square<uint8_t>([](Square s) {
+    return uint8_t(s == E1 ? ~12 : s == H1 ? ~8 : s == A1 ? ~4
+                 : s == E8 ?  ~3 : s == H8 ? ~2 : s == A8 ? ~1 : ~0);
+});
+
+inline Bitboard align_mask(Square ksq, Square pinned) {
+    return AlignMask[ksq][pinned];
+}
+
+inline Bitboard main_diag(Square s) {
+    return MainDiag[s];
+}
+
+inline Bitboard anti_diag(Square s) {
+    return AntiDiag[s];
+}
+
+inline Bitboard file_bb(Square s) {
+    return FileBB[s];
+}
+
+inline Bitboard double_check(Square ksq) {
+    return DoubleCheck[ksq];
+}
+
+inline Bitboard check_ray(Square ksq, Square checker) {
+    return CheckRay[ksq][checker];
+}
+
+inline Bitboard rank_bb(Square s) {
+    return RANK_1 << 8 * (s / 8);
+}
+
+inline std::string to_string(Bitboard b)
+{
+    std::string l = "+---+---+---+---+---+---+---+---+\n", s = l;
+
+    for (Bitboard bit = square_bb(A8); bit; bit >>= 1)
+    {
+        s += (bit & b) ? "| @ " : "|   ";
+
+        if (bit & FILE_H)
+            s += "|\n" + l;
+    }
+
+    return s + "\n";
+}
+
+inline void clear_lsb(Bitboard& b) {
+    b = _blsr_u64(b);
+}
+
+inline uint64_t more_than_one(Bitboard b) {
+    return _blsr_u64(b);
+}
+
+inline Bitboard knight_attacks(Square sq) {
+    return KnightAttacks[sq];
+}
+
+Bitboard attacks_bb(PieceType pt, Square sq, Bitboard occupied);
+
+// Switches attacks_bb() from walking rays to pext indexed tables. Call it before starting
+// the threads of a mode that generates moves for millions of positions
+void build_slider_tables();
+
+inline Bitboard xray_bb(PieceType pt, Square sq, Bitboard occupied) {
+    return attacks_bb(pt, sq, occupied ^ attacks_bb(pt, sq, occupied) & occupied);
+}
+
+inline Bitboard king_attacks(Square sq) {
+    return KingAttacks[sq];
+}
+
+template<Color C>
+constexpr Bitboard pawn_attacks(Square sq) {
+    return PawnAttacks[C][sq];
+}
+
+inline void toggle_square(Bitboard& b, Square s) {
+    b ^= 1ull << s;
+}
+
+inline Bitboard generate_occupancy(Bitboard mask, int permutation) {
+    return _pdep_u64(permutation, mask);
+}
+
+inline int square_distance(Square a, Square b) {
+    return SquareDistance[a][b];
+}
+
+inline int file_distance(Square a, Square b) {
+    return std::abs((a % 8) - (b % 8));
+}
+
+inline int rank_distance(Square a, Square b) {
+    return std::abs((a / 8) - (b / 8));
+}
+
 #endif
\ No newline at end of file
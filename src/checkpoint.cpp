@@ -0,0 +1,105 @@
+
+#include "checkpoint.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <windows.h>
+
+bool save_checkpoint(const std::string& path, const CheckpointHeader& header, const std::vector<MatchState>& states)
+{
+    std::ostringstream ss;
+
+    ss << "checkpoint 2\n"
+       << "engine1 "  << header.engine1  << "\n"
+       << "engine2 "  << header.engine2  << "\n"
+       << "fen_file " << header.fen_file << "\n"
+       << "fens "     << header.fens     << "\n"
+       << "time "     << header.time     << "\n"
+       << "matches "  << states.size()   << "\n";
+
+    for (const MatchState& s : states)
+    {
+        ss << s.seed << " " << s.e1_wins << " " << s.e2_wins << " " << s.draws << " ";
+
+        for (size_t i = 0; i < s.done.size(); i += 4)
+        {
+            int nibble = 0;
+
+            for (size_t j = i; j < std::min(i + 4, s.done.size()); j++)
+                nibble |= s.done[j] << (j - i);
+
+            ss << "0123456789abcdef"[nibble];
+        }
+
+        ss << "\n";
+    }
+
+    ss << "end\n";
+
+    return replace_file(path, ss.str());
+}
+
+bool replace_file(const std::string& path, const std::string& data)
+{
+    std::string tmp = path + ".tmp";
+
+    HANDLE file = CreateFileA(tmp.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    DWORD written;
+    bool ok = WriteFile(file, data.c_str(), data.size(), &written, NULL) && written == data.size() && FlushFileBuffers(file);
+
+    CloseHandle(file);
+
+    return ok && MoveFileExA(tmp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+}
+
+bool load_checkpoint(const std::string& path, CheckpointHeader& header, std::vector<MatchState>& states)
+{
+    std::ifstream in(path);
+    std::string token;
+    int version, matches;
+
+    if (!(in >> token >> version) || token != "checkpoint" || version != 2)
+        return false;
+
+    in >> token; std::getline(in >> std::ws, header.engine1);
+    in >> token; std::getline(in >> std::ws, header.engine2);
+    in >> token; std::getline(in >> std::ws, header.fen_file);
+
+    in >> token >> header.fens
+       >> token >> header.time
+       >> token >> matches;
+
+    if (!in || matches <= 0 || header.fens <= 0)
+        return false;
+
+    states.resize(matches);
+
+    // One hex digit per 4 openings, the first opening in the lowest bit
+    for (MatchState& s : states)
+    {
+        std::string done;
+
+        if (!(in >> s.seed >> s.e1_wins >> s.e2_wins >> s.draws >> done) || done.size() != size_t(header.fens + 3) / 4)
+            return false;
+
+        s.done.assign(header.fens, false);
+
+        for (int i = 0; i < header.fens; i++)
+        {
+            char c      = done[i / 4];
+            int  nibble = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+
+            if (nibble < 0)
+                return false;
+
+            s.done[i] = nibble >> (i % 4) & 1;
+        }
+    }
+
+    return (in >> token) && token == "end";
+}
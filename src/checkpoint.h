@@ -0,0 +1,35 @@
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One pass over the openings, shuffled with seed. done is indexed by position in the shuffled order
+struct MatchState
+{
+    uint64_t          seed;
+    int               e1_wins;
+    int               e2_wins;
+    int               draws;
+    std::vector<bool> done;
+};
+
+struct CheckpointHeader
+{
+    std::string engine1;
+    std::string engine2;
+    std::string fen_file;
+    int         fens;
+    int         time;
+};
+
+// Written with replace_file(), so a crash at any point leaves either the old or the new checkpoint
+bool save_checkpoint(const std::string& path, const CheckpointHeader& header, const std::vector<MatchState>& states);
+bool load_checkpoint(const std::string& path, CheckpointHeader& header, std::vector<MatchState>& states);
+
+// Writes data to a temporary file, flushes it to disk and renames it over path
+bool replace_file(const std::string& path, const std::string& data);
+
+#endif
@@ -0,0 +1,192 @@
+
+#include "control.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+void Control::stop()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    m_stopped = true;
+}
+
+void Control::pause()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    m_paused = true;
+}
+
+void Control::resume()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        m_stopped = m_paused = false;
+    }
+
+    cv.notify_all();
+}
+
+void Control::drain()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        m_draining = true;
+    }
+
+    cv.notify_all();
+}
+
+void Control::quit()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        m_quitting = true;
+    }
+
+    cv.notify_all();
+}
+
+void Control::set_threads(int threads)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        m_active = std::clamp(threads, 1, m_threads);
+    }
+
+    cv.notify_all();
+}
+
+bool Control::next_move()
+{
+    if (!m_stopped)
+        return !m_quitting;
+
+    std::unique_lock<std::mutex> lock(mtx);
+    cv.wait(lock, [&] { return !m_stopped || m_quitting; });
+    return !m_quitting;
+}
+
+bool Control::next_game(int id)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+
+    m_parked++;
+    cv.wait(lock, [&] { return m_quitting || m_draining || (!m_stopped && !m_paused && id < m_active); });
+    m_parked--;
+
+    return !m_quitting && !m_draining;
+}
+
+bool Control::quitting() const
+{
+    return m_quitting;
+}
+
+bool Control::draining() const
+{
+    return m_draining;
+}
+
+bool Control::paused() const
+{
+    return m_stopped || m_paused;
+}
+
+int Control::active() const
+{
+    return m_active;
+}
+
+void Control::print() const
+{
+    std::function<void()> stats;
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        printf("%s, %d of %d threads active, %d waiting for a game\n",
+               m_quitting ? "Quitting" : m_draining ? "Draining" : m_stopped ? "Stopped" : m_paused ? "Paused" : "Running",
+               m_active.load(), m_threads, m_parked);
+
+        stats = m_stats;
+    }
+
+    if (stats)
+        stats();
+}
+
+void Control::set_stats(std::function<void()> stats)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    m_stats = stats;
+}
+
+void Control::record_overshoot(int64_t us)
+{
+    thread_local OvershootShard *shard = nullptr;
+    thread_local const Control  *owner = nullptr;
+
+    if (owner != this)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        m_shards.push_back(std::make_unique<OvershootShard>());
+        shard = m_shards.back().get();
+        owner = this;
+    }
+
+    std::lock_guard<std::mutex> lock(shard->mtx);
+    shard->overshoot.record(us);
+}
+
+Histogram Control::take_overshoot()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+
+    Histogram h;
+
+    for (auto& shard : m_shards)
+    {
+        std::lock_guard<std::mutex> shard_lock(shard->mtx);
+
+        h.merge(shard->overshoot);
+        shard->overshoot.clear();
+    }
+
+    return h;
+}
+
+void handle_stdin(Control *control)
+{
+    for (std::string line; std::getline(std::cin, line);)
+    {
+        std::istringstream is(line);
+        std::string command;
+        int threads;
+
+        if (!(is >> command))
+            continue;
+
+        if (command == "stop")
+            control->stop();
+        else if (command == "pause")
+            control->pause();
+        else if (command == "go")
+            control->resume();
+        else if (command == "drain")
+            control->drain();
+        else if (command == "threads" && is >> threads)
+            control->set_threads(threads);
+        else if (command == "stats")
+            control->print();
+        else if (command == "quit")
+        {
+            control->quit();
+            return;
+        }
+        else
+            std::cout << "Unknown command '" << line << "'" << std::endl;
+    }
+}
@@ -0,0 +1,68 @@
+
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "histogram.h"
+
+// Commands from stdin to the worker threads. Workers block on a condition variable instead
+// of polling, so pause, resume and quit take effect as soon as the current move or game ends.
+// Worker ids at or above active() park between games, which shrinks a run without losing games.
+// The flags are atomics, so a move only takes the lock while the run is stopped
+class Control
+{
+public:
+    explicit Control(int threads) : m_threads(threads), m_active(threads) {}
+
+    void stop();             // pause between moves
+    void pause();            // pause between games
+    void resume();
+    void drain();            // finish the games in flight, then end the run
+    void quit();             // abort the games in flight and end the run
+    void set_threads(int threads);
+
+    bool next_move();        // false when the game should be aborted
+    bool next_game(int id);  // false when the worker should exit
+
+    bool quitting() const;
+    bool draining() const;
+    bool paused() const;     // stopped or paused
+    int  active() const;     // lock free, for the metrics exporter
+    void print() const;
+    void set_stats(std::function<void()> stats);
+
+    void      record_overshoot(int64_t us);
+    Histogram take_overshoot();  // overshoot of all moves since the last call
+
+private:
+    // One per recording thread, only contended while take_overshoot() merges it
+    struct OvershootShard
+    {
+        std::mutex mtx;
+        Histogram  overshoot;
+    };
+
+    std::function<void()>                        m_stats;
+    std::vector<std::unique_ptr<OvershootShard>> m_shards;
+
+    mutable std::mutex      mtx;
+    std::condition_variable cv;
+
+    int               m_threads;
+    std::atomic<int>  m_active;
+    int               m_parked   = 0;
+    std::atomic<bool> m_stopped  = false;
+    std::atomic<bool> m_paused   = false;
+    std::atomic<bool> m_draining = false;
+    std::atomic<bool> m_quitting = false;
+};
+
+void handle_stdin(Control *control);
+
+#endif
@@ -0,0 +1,519 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define NOMINMAX
+
+#include "coordinator.h"
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "metrics.h"
+#include "misc.h"
+#include "results.h"
+#include "stats.h"
+
+#pragma comment(lib, "ws2_32.lib")
+
+// Protocol, one command per line. The worker introduces itself with
+//   worker <threads>, engine1 <name>, engine2 <name>
+// and gets 'time <movetime> worker <number>' or 'error <reason>' back. Then it sends
+//   lease <n>                                  answered by 'batch <k> <finished> <total> <e1 wins> <e2 wins> <draws>'
+//                                              and k lines 'game <pass> <index> <e1 color> <fen>', or by 'wait' or 'done'
+//   result <pass> <index> <e1 result> <plies> <white score> <state> <exit eval>
+//                                              e1 result and white score are 1, 0 or -1, plies 0 for a crash or time loss
+//   release <pass> <index>                     a game it will not play after all
+//   alive                                      every 10 seconds, so a silent worker is known to be lost
+
+namespace {
+
+// A host that died or lost the network closes no connection. Each side gives up on the other
+// once it has heard nothing for TimeoutSeconds, which the worker's heartbeats prevent
+constexpr int HeartbeatSeconds = 10;
+constexpr int TimeoutSeconds   = 60;
+
+}
+
+Connection::Connection(uintptr_t socket) : m_socket(socket)
+{
+    // Leases and results are single short lines that should not wait for more to send
+    BOOL nodelay = TRUE;
+    setsockopt(m_socket, IPPROTO_TCP, TCP_NODELAY, (const char*)&nodelay, sizeof(nodelay));
+}
+
+Connection::~Connection()
+{
+    closesocket(m_socket);
+}
+
+bool Connection::read_line(std::string& line)
+{
+    char buffer[4096];
+
+    for (size_t end; (end = m_buffer.find('\n')) == std::string::npos;)
+    {
+        int n = recv(m_socket, buffer, sizeof(buffer), 0);
+
+        if (n <= 0)
+            return false;
+
+        m_buffer.append(buffer, n);
+    }
+
+    size_t end = m_buffer.find('\n');
+
+    line = m_buffer.substr(0, end && m_buffer[end - 1] == '\r' ? end - 1 : end);
+    m_buffer.erase(0, end + 1);
+
+    return true;
+}
+
+bool Connection::send(const std::string& text)
+{
+    for (size_t sent = 0; sent < text.size();)
+    {
+        int n = ::send(m_socket, text.data() + sent, text.size() - sent, 0);
+
+        if (n <= 0)
+            return false;
+
+        sent += n;
+    }
+
+    return true;
+}
+
+void Connection::shutdown()
+{
+    ::shutdown(m_socket, SD_BOTH);
+}
+
+void Connection::set_timeout(int seconds)
+{
+    DWORD ms = seconds * 1000;
+    setsockopt(m_socket, SOL_SOCKET, SO_RCVTIMEO, (const char*)&ms, sizeof(ms));
+}
+
+RemoteQueue::RemoteQueue(std::unique_ptr<Connection> connection, int batch, Control *control)
+    : played{ 0, 0, 0, 0 }, m_connection(std::move(connection)), m_control(control), m_batch(batch),
+      m_done(false), m_lost(false), m_totals{ 0, 0, 0, 0 }
+{
+}
+
+void RemoteQueue::lost()
+{
+    if (!m_lost)
+        printf("%s The coordinator closed the connection\n", time_().c_str());
+
+    m_done = m_lost = true;
+    pending.clear();
+}
+
+bool RemoteQueue::next(QueuedGame& game)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+
+    while (pending.empty() && !m_done)
+    {
+        std::string line, token;
+
+        if (!m_connection->send("lease " + std::to_string(m_batch) + "\n") || !m_connection->read_line(line))
+        {
+            lost();
+            break;
+        }
+
+        std::istringstream is(line);
+        int k, finished_;
+
+        is >> token;
+
+        if (token == "batch" && is >> k >> finished_ >> total >> m_totals.e1_wins >> m_totals.e2_wins >> m_totals.draws)
+        {
+            finished = finished_;
+
+            for (int i = 0; i < k && !m_lost; i++)
+            {
+                int color;
+
+                if (!m_connection->read_line(line) || !(std::istringstream(line) >> token >> game.pass >> game.index >> color) || token != "game")
+                {
+                    lost();
+                    break;
+                }
+
+                game.e1_color = Color(color);
+
+                size_t fen = line.find(' ', line.find(' ', line.find(' ', line.find(' ') + 1) + 1) + 1);
+
+                pending.push_back(game);
+                fens[{ game.pass, game.index }] = line.substr(fen + 1);
+            }
+        }
+        else if (token == "wait" && !m_control->quitting() && !m_control->draining())
+        {
+            // Every game is out, but a worker that drops its connection gives its games back
+            lock.unlock();
+            Sleep(1000);
+            lock.lock();
+        }
+        else
+            m_done = true;
+    }
+
+    if (pending.empty())
+        return false;
+
+    game = pending.front();
+    pending.pop_front();
+
+    return true;
+}
+
+void RemoteQueue::release(const QueuedGame& game)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+
+    fens.erase({ game.pass, game.index });
+
+    if (!m_lost && !m_connection->send("release " + std::to_string(game.pass) + " " + std::to_string(game.index) + "\n"))
+        lost();
+}
+
+int RemoteQueue::report(const QueuedGame& game, int e1_result, const OpeningOutcome& outcome)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+
+    fens.erase({ game.pass, game.index });
+
+    (e1_result > 0 ? played.e1_wins : e1_result < 0 ? played.e2_wins : played.draws)++;
+
+    if (!m_lost && !m_connection->send("result " + std::to_string(game.pass) + " " + std::to_string(game.index) + " "
+                                      + std::to_string(e1_result) + " " + std::to_string(outcome.plies) + " " + std::to_string(outcome.white_score) + " "
+                                      + std::to_string(outcome.state) + " " + std::to_string(outcome.exit_eval) + "\n"))
+        lost();
+
+    return ++finished;
+}
+
+void RemoteQueue::heartbeat()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+
+    if (!m_lost && !m_connection->send("alive\n"))
+        lost();
+}
+
+const std::string& RemoteQueue::fen(const QueuedGame& game)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return fens.at({ game.pass, game.index });
+}
+
+MatchState RemoteQueue::totals()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return m_totals;
+}
+
+int run_worker(const std::string& address, const std::string& engine1, const std::string& engine2, int threads,
+               Control *control, const std::string& datagen, uint64_t rotate)
+{
+    size_t      colon = address.rfind(':');
+    std::string host  = address.substr(0, colon), port = colon == std::string::npos ? "" : address.substr(colon + 1);
+
+    WSADATA   wsa;
+    addrinfo  hints = {}, *found;
+    SOCKET    s = INVALID_SOCKET;
+
+    hints.ai_family   = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+
+    if (!port.empty() && WSAStartup(MAKEWORD(2, 2), &wsa) == 0 && getaddrinfo(host.c_str(), port.c_str(), &hints, &found) == 0)
+    {
+        for (addrinfo *a = found; a && s == INVALID_SOCKET; a = a->ai_next)
+            if ((s = socket(a->ai_family, a->ai_socktype, a->ai_protocol)) != INVALID_SOCKET && connect(s, a->ai_addr, (int)a->ai_addrlen) != 0)
+            {
+                closesocket(s);
+                s = INVALID_SOCKET;
+            }
+
+        freeaddrinfo(found);
+    }
+
+    if (s == INVALID_SOCKET)
+    {
+        printf("Could not connect to the coordinator at %s\n", address.c_str());
+        return 1;
+    }
+
+    auto connection = std::make_unique<Connection>(s);
+
+    connection->set_timeout(TimeoutSeconds);
+
+    std::string name1 = engine_name(engine1), name2 = engine_name(engine2), line, token;
+    int time = 0, number = 0;
+
+    if (   !connection->send("worker " + std::to_string(threads) + "\nengine1 " + name1 + "\nengine2 " + name2 + "\n")
+        || !connection->read_line(line)
+        || !(std::istringstream(line) >> token >> time >> token >> number) || !time)
+    {
+        printf("The coordinator at %s refused this worker: %s\n", address.c_str(), line.c_str());
+        return 1;
+    }
+
+    printf("%s Worker %d of the coordinator at %s, %d ms per move\n", time_().c_str(), number, address.c_str(), time);
+
+    RemoteQueue queue(std::move(connection), 2 * threads, control);
+
+    // From before the engines are started, which may take a while
+    std::atomic<bool> done = false;
+
+    std::thread heartbeat([&]() {
+        for (uint64_t last = unix_ms(); !done; Sleep(100))
+            if (unix_ms() - last >= HeartbeatSeconds * 1000ull)
+            {
+                queue.heartbeat();
+                last = unix_ms();
+            }
+    });
+
+    std::vector<Match*>      matches(threads, nullptr);
+    std::vector<std::thread> thread_pool;
+
+    // As in a local match, a slot starts its engines once it is first let play
+    for (int id = 0; id < threads; id++)
+        thread_pool.emplace_back([&, id]() {
+            if (!control->next_game(id))
+                return;
+
+            matches[id] = new Match(engine1, engine2, time, id, datagen, rotate, "_w" + std::to_string(number));
+            matches[id]->run(control, queue);
+        });
+
+    control->set_stats([&]() {
+        MatchState t = queue.totals();
+
+        printf("%s %d %s %d Draws %d (%+d +/- %d) Game %d/%d\n", name1.c_str(), t.e1_wins, name2.c_str(), t.e2_wins, t.draws,
+               (int)elo_diff(t.e1_wins, t.e2_wins, t.draws), (int)elo_margin(t.e1_wins, t.e2_wins, t.draws), queue.finished.load(), queue.total);
+    });
+
+    for (std::thread& thread : thread_pool)
+        thread.join();
+
+    control->set_stats(nullptr);
+
+    done = true;
+    heartbeat.join();
+
+    EngineSummary e1 = { name1 }, e2 = { name2 };
+
+    for (Match *m : matches)
+    {
+        if (!m)
+            continue;
+
+        e1.times.merge(m->e1.times);
+        e2.times.merge(m->e2.times);
+        e1.search.merge(m->e1.search);
+        e2.search.merge(m->e2.search);
+        e1.usage.merge(m->e1.usage());
+        e2.usage.merge(m->e2.usage());
+        delete m;
+    }
+
+    e1.wins = e2.losses = queue.played.e1_wins;
+    e2.wins = e1.losses = queue.played.e2_wins;
+    e1.draws = e2.draws = queue.played.draws;
+
+    printf("\nWorker %d played %s %d %s %d Draws %d\n", number, name1.c_str(), e1.wins, name2.c_str(), e2.wins, e1.draws);
+
+    print_summary({ e1, e2 });
+
+    WSACleanup();
+
+    return 0;
+}
+
+namespace {
+
+// State of run_coordinator() shared with the threads serving the workers
+struct Run
+{
+    MatchQueue&      queue;
+    std::string      engine1;
+    std::string      engine2;
+    int              time;
+    Control         *control;
+    std::atomic<int> leased;  // games in the hands of workers
+};
+
+struct Worker
+{
+    std::unique_ptr<Connection> connection;
+    std::thread                 thread;
+};
+
+void serve(Connection& connection, int number, Run& run)
+{
+    std::string line, token, threads, name1, name2;
+
+    connection.set_timeout(TimeoutSeconds);
+
+    auto field = [&](const char *key, std::string& value) {
+        if (!connection.read_line(line) || line.rfind(std::string(key) + " ", 0) != 0)
+            return false;
+
+        value = line.substr(strlen(key) + 1);
+        return true;
+    };
+
+    if (!field("worker", threads) || !field("engine1", name1) || !field("engine2", name2))
+        return;
+
+    if (name1 != run.engine1 || name2 != run.engine2)
+    {
+        printf("%s Worker %d refused, it plays %s vs %s\n", time_().c_str(), number, name1.c_str(), name2.c_str());
+        connection.send("error this run is " + run.engine1 + " vs " + run.engine2 + "\n");
+        return;
+    }
+
+    connection.send("time " + std::to_string(run.time) + " worker " + std::to_string(number) + "\n");
+
+    printf("%s Worker %d connected with %s threads\n", time_().c_str(), number, threads.c_str());
+
+    std::set<std::pair<int, int>> leased;
+
+    while (connection.read_line(line))
+    {
+        std::istringstream is(line);
+        QueuedGame game;
+        OpeningOutcome outcome;
+        int n, result, state;
+
+        is >> token;
+
+        if (token == "lease" && is >> n)
+        {
+            bool stopping = run.control->quitting() || run.control->draining();
+            std::string games;
+            int k = 0;
+
+            for (; !stopping && !run.control->paused() && k < n && run.queue.next(game); k++)
+            {
+                leased.insert({ game.pass, game.index });
+                games += "game " + std::to_string(game.pass) + " " + std::to_string(game.index) + " " + std::to_string(game.e1_color) + " " + run.queue.fen(game) + "\n";
+            }
+
+            run.leased += k;
+
+            MatchState t = run.queue.totals();
+
+            std::string reply = k ? "batch " + std::to_string(k) + " " + std::to_string(run.queue.finished) + " " + std::to_string(run.queue.total) + " "
+                                  + std::to_string(t.e1_wins) + " " + std::to_string(t.e2_wins) + " " + std::to_string(t.draws) + "\n" + games
+                              : stopping || run.queue.finished == run.queue.total ? "done\n" : "wait\n";
+
+            if (!connection.send(reply))
+                break;
+        }
+        else if (   token == "result" && is >> game.pass >> game.index >> result >> outcome.plies >> outcome.white_score >> state >> outcome.exit_eval
+                 && state >= ONGOING && state <= FIFTY_MOVE && leased.erase({ game.pass, game.index }))
+        {
+            outcome.state = GameState(state);
+
+            int finished = run.queue.report(game, result, outcome);
+
+            run.leased--;
+            metrics().set_progress(finished, run.queue.total);
+
+            MatchState t = run.queue.totals();
+
+            printf("%s Worker %d Game %d/%d %s %d %s %d Draws %d (%+d +/- %d)\n",
+                   time_().c_str(), number, finished, run.queue.total,
+                   run.engine1.c_str(), t.e1_wins, run.engine2.c_str(), t.e2_wins, t.draws,
+                   (int)elo_diff(t.e1_wins, t.e2_wins, t.draws), (int)elo_margin(t.e1_wins, t.e2_wins, t.draws));
+        }
+        else if (token == "release" && is >> game.pass >> game.index && leased.erase({ game.pass, game.index }))
+        {
+            run.queue.release(game);
+            run.leased--;
+        }
+    }
+
+    // Lost or finished, whatever it did not report is played by someone else
+    for (auto [pass, index] : leased)
+        run.queue.release({ pass, index });
+
+    run.leased -= leased.size();
+
+    if (leased.empty())
+        printf("%s Worker %d disconnected or went silent\n", time_().c_str(), number);
+    else
+        printf("%s Worker %d disconnected or went silent, its %zu unfinished games go back into the queue\n", time_().c_str(), number, leased.size());
+}
+
+}
+
+void run_coordinator(MatchQueue& queue, int port, const std::string& engine1, const std::string& engine2, int time, Control *control)
+{
+    Run run = { queue, engine1, engine2, time, control, 0 };
+
+    WSADATA     wsa;
+    sockaddr_in addr = {};
+
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    SOCKET listener = WSAStartup(MAKEWORD(2, 2), &wsa) == 0 ? socket(AF_INET, SOCK_STREAM, IPPROTO_TCP) : INVALID_SOCKET;
+
+    if (listener == INVALID_SOCKET || bind(listener, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listener, 64) != 0)
+    {
+        printf("Could not listen on port %d\n", port);
+        return;
+    }
+
+    printf("%s Coordinating %s vs %s on port %d, %d of %d games left\n",
+           time_().c_str(), engine1.c_str(), engine2.c_str(), port, queue.total - queue.finished.load(), queue.total);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    while (!control->quitting() && queue.finished < queue.total && !(control->draining() && run.leased == 0))
+    {
+        fd_set  readable;
+        timeval timeout = { 0, 100000 };
+
+        FD_ZERO(&readable);
+        FD_SET(listener, &readable);
+
+        if (select(int(listener) + 1, &readable, NULL, NULL, &timeout) != 1)
+            continue;
+
+        SOCKET s = accept(listener, NULL, NULL);
+
+        if (s == INVALID_SOCKET)
+            continue;
+
+        workers.push_back(std::make_unique<Worker>());
+        workers.back()->connection = std::make_unique<Connection>(s);
+        workers.back()->thread     = std::thread(serve, std::ref(*workers.back()->connection), int(workers.size()), std::ref(run));
+    }
+
+    closesocket(listener);
+
+    for (auto& w : workers)
+        w->connection->shutdown();
+
+    for (auto& w : workers)
+        w->thread.join();
+
+    WSACleanup();
+}
@@ -0,0 +1,75 @@
+
+#ifndef COORDINATOR_H
+#define COORDINATOR_H
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "control.h"
+#include "mm.h"
+
+// Line based TCP connection between the coordinator and a worker
+class Connection
+{
+public:
+    explicit Connection(uintptr_t socket);
+   ~Connection();
+
+    bool read_line(std::string& line);
+    bool send(const std::string& text);
+    void shutdown();  // a read_line() blocked on another thread returns false
+    void set_timeout(int seconds);  // a read_line() that waits longer returns false
+
+private:
+    uintptr_t   m_socket;
+    std::string m_buffer;
+};
+
+// Worker side of a distributed match: leases a batch of games from the coordinator whenever
+// it has none left, and sends each result back as soon as the game is over. Once the
+// coordinator is gone the games in hand are dropped, the coordinator gives them to others
+class RemoteQueue : public GameQueue
+{
+public:
+    RemoteQueue(std::unique_ptr<Connection> connection, int batch, Control *control);
+
+    bool next(QueuedGame& game) override;
+    void release(const QueuedGame& game) override;
+    int  report(const QueuedGame& game, int e1_result, const OpeningOutcome& outcome) override;
+    void heartbeat();
+
+    const std::string& fen(const QueuedGame& game) override;
+    MatchState totals() override;  // of the whole run, as of the last lease
+
+    MatchState played;  // by this worker
+
+private:
+    void lost();
+
+    std::mutex                                 mtx;
+    std::unique_ptr<Connection>                m_connection;
+    Control                                   *m_control;
+    int                                        m_batch;
+    bool                                       m_done;
+    bool                                       m_lost;
+    std::deque<QueuedGame>                     pending;
+    std::map<std::pair<int, int>, std::string> fens;  // of the games in hand
+    MatchState                                 m_totals;
+};
+
+// --worker=host:port: plays games leased from the coordinator on --threads threads with the
+// local --engine1 and --engine2, which must have the same names as the coordinator's
+int run_worker(const std::string& address, const std::string& engine1, const std::string& engine2, int threads,
+               Control *control, const std::string& datagen, uint64_t rotate);
+
+// --coordinator=port: hands the games of the queue out to the workers that connect until all
+// are finished, or the run is drained or quit. Games of a worker that disconnects, or sends
+// nothing for a minute, go back into the queue
+void run_coordinator(MatchQueue& queue, int port, const std::string& engine1, const std::string& engine2, int time, Control *control);
+
+#endif
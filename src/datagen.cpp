@@ -0,0 +1,128 @@
+
+#include "datagen.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "bitboard.h"
+#include "uci.h"
+
+PackedPos pack(const Position& pos, int score, int ply)
+{
+    PackedPos p;
+    memset(&p, 0, sizeof(PackedPos));
+
+    p.occupied = pos.occupied();
+
+    int i = 0;
+    for (Bitboard b = p.occupied; b; clear_lsb(b), i++)
+        p.pieces[i / 2] |= pos.piece_on(lsb(b)) << 4 * (i & 1);
+
+    p.score          = std::clamp(score, -VALUE_MATE, VALUE_MATE);
+    p.stm_castling   = pos.side_to_move() | pos.castling_rights() << 4;
+    p.ep_sq          = pos.ep_sq();
+    p.halfmove_clock = pos.halfmove_clock();
+    p.ply            = ply;
+
+    return p;
+}
+
+std::string unpack(const PackedPos& p)
+{
+    Piece board[SQUARE_NB] = {};
+
+    int i = 0;
+    for (Bitboard b = p.occupied; b; clear_lsb(b), i++)
+        board[lsb(b)] = p.pieces[i / 2] >> 4 * (i & 1) & 0xf;
+
+    std::string fen;
+
+    for (int rank = 7; rank >= 0; rank--)
+    {
+        for (int file = 7, empty = 0; file >= 0; file--)
+        {
+            if (Piece pc = board[rank * 8 + file])
+                fen += "  PNBRQK  pnbrqk"[pc];
+            else
+                empty++;
+
+            if (empty && (file == 0 || board[rank * 8 + file - 1]))
+                fen += char('0' + empty), empty = 0;
+        }
+
+        fen += rank ? "/" : " ";
+    }
+
+    fen += "wb"[p.stm_castling & 1];
+    fen += " ";
+
+    for (int bit = 3; bit >= 0; bit--)
+        if (p.stm_castling >> 4 & 1 << bit)
+            fen += "qkQK"[bit];
+
+    if (!(p.stm_castling >> 4))
+        fen += "-";
+
+    fen += " " + (p.ep_sq ? square_to_uci(p.ep_sq) : "-") + " " + std::to_string(p.halfmove_clock);
+
+    return fen;
+}
+
+DataWriter::DataWriter(const std::string& prefix, uint64_t rotate) : m_prefix (prefix),
+                                                                     m_rotate (rotate),
+                                                                     m_in_file(0),
+                                                                     m_written(0),
+                                                                     m_file_id(0)
+{
+    buffer.reserve(BufferSize);
+}
+
+void DataWriter::open_next()
+{
+    out.close();
+    out.open(m_prefix + "_" + std::to_string(m_file_id++) + ".bin", std::ios::binary);
+    m_in_file = 0;
+
+    if (!out)
+    {
+        std::cerr << "Could not open " << m_prefix << "_" << m_file_id - 1 << ".bin" << std::endl;
+        std::exit(1);
+    }
+}
+
+// Files are only rotated between games, so every file holds whole games that --verify can
+// check on their own. A file ends with the first game that takes it to rotate records or more
+void DataWriter::write(const PackedPos *records, size_t n)
+{
+    if (m_in_file + buffer.size() >= m_rotate)
+    {
+        flush();
+        open_next();
+    }
+
+    for (size_t i = 0; i < n; i++)
+    {
+        buffer.push_back(records[i]);
+
+        if (buffer.size() == BufferSize)
+            flush();
+    }
+}
+
+void DataWriter::flush()
+{
+    if (buffer.empty())
+        return;
+
+    if (!out.is_open())
+        open_next();
+
+    out.write((const char*)buffer.data(), buffer.size() * sizeof(PackedPos));
+    out.flush();
+
+    m_in_file += buffer.size();
+    m_written += buffer.size();
+
+    buffer.clear();
+}
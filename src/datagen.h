@@ -0,0 +1,59 @@
+
+#ifndef DATAGEN_H
+#define DATAGEN_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "position.h"
+#include "types.h"
+
+enum { BLACK_WIN, DRAW_RESULT, WHITE_WIN };
+
+// 32-byte training record. Pieces are stored as 4-bit Piece codes in lsb order of 'occupied'
+#pragma pack(push, 1)
+struct PackedPos
+{
+    uint64_t occupied;
+    uint8_t  pieces[16];
+    int16_t  score;
+    uint8_t  stm_castling;
+    uint8_t  ep_sq;
+    uint8_t  halfmove_clock;
+    uint8_t  result;
+    uint16_t ply;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(PackedPos) == 32);
+
+PackedPos pack(const Position& pos, int score, int ply);
+std::string unpack(const PackedPos& p);  // FEN of the record, in the format of Position::fen
+
+class DataWriter
+{
+public:
+    DataWriter(const std::string& prefix, uint64_t rotate);
+   ~DataWriter() { flush(); }
+
+    void write(const PackedPos *records, size_t n);  // the records of one whole game
+    void flush();
+
+    uint64_t written() const { return m_written; }
+
+private:
+    void open_next();
+
+    static constexpr size_t BufferSize = 1 << 15;
+
+    std::ofstream          out;
+    std::vector<PackedPos> buffer;
+    std::string            m_prefix;
+    uint64_t               m_rotate;
+    uint64_t               m_in_file;
+    uint64_t               m_written;
+    int                    m_file_id;
+};
+
+#endif
@@ -1,101 +1,546 @@
-
-#include "engine.h"
-
-#include <iostream>
-#include <cctype>
-#include <chrono>
-#include <thread>
-#include <sstream>
-
-std::string Engine::best_move()
-{
-    write_to_stdin("go movetime " + std::to_string(m_thinktime) + "\n");
-
-    std::string std_out, token;
-
-    for (std_out = read_stdout();
-         std_out.find("bestmove") == std::string::npos || std_out.find('\n', std_out.rfind("bestmove")) == std::string::npos;
-         std_out += read_stdout())
-    {}
-
-    std::istringstream is(std_out.substr(std_out.rfind("bestmove")));
-    is >> token >> token;
-    return token;
-}
-
-void Engine::write_to_stdin(const std::string& message)
-{
-    DWORD written;
-    WriteFile(m_stdin, message.c_str(), message.size(), &written, NULL);
-    FlushFileBuffers(m_stdin);
-}
-
-std::string Engine::read_stdout()
-{
-    const int bufferSize = 4096;
-    char      buffer[bufferSize];
-    DWORD     read;
-
-    if (!ReadFile(m_stdout, buffer, bufferSize - 1, &read, NULL) || read == 0)
-        return "";
-
-    buffer[read] = '\0';
-
-    return std::string(buffer);
-}
-
-Engine::Engine(const std::string& path, int thinktime, int id) : m_stdin    (NULL),
-                                                                 m_stdout   (NULL),
-                                                                 m_thinktime(thinktime),
-                                                                 wins       (0),
-                                                                 m_id       (id)
-{
-    std::string relative_path = path.find('\\') == std::string::npos ? path : path.substr(path.rfind('\\') + 1);
-    m_name = relative_path.substr(0, relative_path.find(".exe"));
-
-    //log.open(std::string("logs\\")+m_name+"_id"+std::to_string(m_id)+".txt");
-
-    PROCESS_INFORMATION piProcInfo;
-    STARTUPINFO siStartInfo;
-    SECURITY_ATTRIBUTES saAttr;
-
-    ZeroMemory(&piProcInfo, sizeof(PROCESS_INFORMATION));
-    ZeroMemory(&siStartInfo, sizeof(STARTUPINFO));
-    siStartInfo.cb = sizeof(STARTUPINFO);
-    saAttr.nLength = sizeof(SECURITY_ATTRIBUTES);
-    saAttr.bInheritHandle = TRUE;
-    saAttr.lpSecurityDescriptor = NULL;
-
-    HANDLE hChildStdoutWr, hChildStdinRd;
-
-    if (!CreatePipe(&m_stdout, &hChildStdoutWr, &saAttr, 0)     ||
-        !SetHandleInformation(m_stdout, HANDLE_FLAG_INHERIT, 0) ||
-        !CreatePipe(&hChildStdinRd, &m_stdin, &saAttr, 0)       ||
-        !SetHandleInformation(m_stdin, HANDLE_FLAG_INHERIT, 0))
-    {
-        std::cerr << "Error creating pipes." << std::endl;
-        std::exit(1);
-    }
-
-    siStartInfo.hStdError = hChildStdoutWr;
-    siStartInfo.hStdOutput = hChildStdoutWr;
-    siStartInfo.hStdInput = hChildStdinRd;
-    siStartInfo.dwFlags |= STARTF_USESTDHANDLES;
-
-    int len = strlen(path.c_str()) + 1;
-    LPWSTR wexe = new WCHAR[len];
-    MultiByteToWideChar(CP_ACP, 0, path.c_str(), -1, wexe, len);
-
-    if (!CreateProcess(NULL, wexe, NULL, NULL, TRUE, 0, NULL, NULL, &siStartInfo, &piProcInfo))
-    {
-        std::cerr << "CreateProcess failed." << std::endl;
-        std::exit(1);
-    }
-
-    delete[] wexe;
-
-    CloseHandle(piProcInfo.hProcess);
-    CloseHandle(piProcInfo.hThread);
-    CloseHandle(hChildStdoutWr);
-    CloseHandle(hChildStdinRd);
-}
+
+#include "engine.h"
+
+#include <algorithm>
+#include <charconv>
+#include <iostream>
+#include <cctype>
+#include <chrono>
+#include <thread>
+#include <string_view>
+#include <psapi.h>
+
+#include "watchdog.h"
+
+namespace {
+
+uint64_t to_micros(const FILETIME& ft) {
+    return ((uint64_t(ft.dwHighDateTime) << 32) | ft.dwLowDateTime) / 10;
+}
+
+std::string_view next_token(std::string_view& s)
+{
+    size_t begin = std::min(s.size(), s.find_first_not_of(" \t\r\n"));
+    size_t end   = std::min(s.size(), s.find_first_of(" \t\r\n", begin));
+
+    std::string_view token = s.substr(begin, end - begin);
+    s.remove_prefix(end);
+
+    return token;
+}
+
+std::atomic<int> recordings {};  // numbers the recordings of a run, engines with the same name and id may be several
+
+}
+
+uint64_t Engine::cpu_time() const
+{
+    FILETIME creation, exit, kernel, user;
+
+    if (!m_process || !GetProcessTimes(m_process, &creation, &exit, &kernel, &user))
+        return 0;
+
+    return to_micros(kernel) + to_micros(user);
+}
+
+ResourceUsage Engine::usage() const
+{
+    ResourceUsage u = m_usage;
+
+    if (!m_process)
+        return u;
+
+    FILETIME creation, exit, kernel, user;
+    PROCESS_MEMORY_COUNTERS pmc;
+
+    ZeroMemory(&pmc, sizeof(pmc));
+
+    if (GetProcessTimes(m_process, &creation, &exit, &kernel, &user))
+    {
+        u.user_seconds   += to_micros(user) / 1e6;
+        u.kernel_seconds += to_micros(kernel) / 1e6;
+    }
+
+    if (GetProcessMemoryInfo(m_process, &pmc, sizeof(pmc)))
+    {
+        u.peak_working_set = std::max<uint64_t>(u.peak_working_set, pmc.PeakWorkingSetSize);
+        u.peak_commit      = std::max<uint64_t>(u.peak_commit, pmc.PeakPagefileUsage);
+        u.page_faults     += pmc.PageFaultCount;
+    }
+
+    u.processes++;
+
+    return u;
+}
+
+void Engine::terminate()
+{
+    m_timed_out = true;
+    TerminateJobObject(m_job, 1);
+
+    if (m_recorder)
+        m_recorder->record(REC_TIMEOUT);
+}
+
+void Engine::kill()
+{
+    if (!m_process)
+        return;
+
+    log.close();
+    write_to_stdin("stop\nquit\n");
+
+    if (WaitForSingleObject(m_process, 1000) != WAIT_OBJECT_0)
+    {
+        TerminateJobObject(m_job, 1);
+        WaitForSingleObject(m_process, INFINITE);
+    }
+
+    m_usage = usage();
+
+    // Anything still queued fails to write once the process is gone
+    {
+        std::lock_guard<std::mutex> lock(m_write_mtx);
+        m_write_quit = true;
+    }
+
+    m_write_cv.notify_one();
+    m_writer.join();
+
+    CloseHandle(m_stdin);
+    CloseHandle(m_stdout);
+    CloseHandle(m_process);
+    CloseHandle(m_job);
+
+    m_stdin = m_stdout = m_process = m_job = NULL;
+}
+
+// Waits for readyok, so the startup of the process is not charged to its first move
+void Engine::handshake()
+{
+    sync("noverbose\nuci\n");
+}
+
+// Commands such as setoption may take a while to apply, which should not be charged to the next move either
+void Engine::sync(const std::string& commands)
+{
+    watchdog().arm(this, std::chrono::steady_clock::now() + std::chrono::milliseconds(10000 + limits.grace_ms));
+
+    write_to_stdin(commands + "isready\n");
+
+    m_output.clear();
+
+    while (m_output.find("readyok") == std::string::npos && read_stdout(m_output));
+
+    watchdog().disarm(this);
+}
+
+std::string Engine::best_move()
+{
+    std::chrono::steady_clock::time_point queued = std::chrono::steady_clock::now();
+
+    uint64_t cpu = cpu_time();
+
+    m_timed_out = false;
+    watchdog().arm(this, queued + std::chrono::milliseconds(m_thinktime + limits.grace_ms));
+
+    write_to_stdin(m_go_command);
+
+    m_score = 0;
+    m_error = ENGINE_OK;
+
+    m_output.clear();
+
+    // Only the newly read text is searched, from 7 bytes back in case "bestmove" was split
+    size_t bestmove = std::string::npos;
+
+    for (size_t from = 0; bestmove == std::string::npos || m_output.find('\n', bestmove) == std::string::npos;)
+    {
+        if (!read_stdout(m_output))
+        {
+            m_error = ENGINE_CRASH;
+            break;
+        }
+
+        if (bestmove == std::string::npos)
+        {
+            bestmove = m_output.find("bestmove", from);
+            from     = m_output.size() - std::min<size_t>(m_output.size(), 7);
+        }
+    }
+
+    watchdog().disarm(this);
+
+    m_bestmove = std::chrono::steady_clock::now();
+
+    // Think time starts when the 'go' was in the pipe, so time the command spent queued
+    // behind MatchManager's own work is not charged to the engine as overshoot. Never later
+    // than the bestmove, so think time cannot come out negative
+    {
+        std::lock_guard<std::mutex> lock(m_write_mtx);
+        m_go = std::min(std::max(queued, m_written), m_bestmove);
+    }
+
+    int64_t think = std::chrono::duration_cast<std::chrono::microseconds>(m_bestmove - m_go).count();
+
+    m_overshoot = std::max<int64_t>(0, think - 1000ll * m_thinktime);
+
+    times.think.record(think);
+    times.overshoot.record(m_overshoot);
+    times.cpu_load.record(100 * (cpu_time() - cpu) / std::max<int64_t>(1, think));
+
+    m_metrics->moves.fetch_add(1, std::memory_order_relaxed);
+    m_metrics->think.record(think);
+    m_metrics->overshoot.record(m_overshoot);
+
+    if (m_timed_out)
+        m_error = ENGINE_TIMEOUT;
+
+    if (replay && m_unrecorded)
+        m_error = ENGINE_NOT_RECORDED;
+
+    if (m_error != ENGINE_OK)
+        return "";
+
+    std::string_view out(m_output);
+
+    if (size_t score = out.rfind("score ", bestmove); score != std::string::npos)
+    {
+        std::string_view rest = out.substr(score);
+        next_token(rest);
+
+        std::string_view type = next_token(rest), value = next_token(rest);
+        int v;
+
+        if (std::from_chars(value.data(), value.data() + value.size(), v).ec == std::errc())
+            m_score = type == "mate" ? (v > 0 ? VALUE_MATE - 2 * v + 1 : -VALUE_MATE - 2 * v)
+                                     : v;
+    }
+
+    record_search(out, bestmove);
+
+    std::string_view rest = out.substr(bestmove);
+    next_token(rest);
+
+    return std::string(next_token(rest));
+}
+
+// Walks back from bestmove to the last info line with a depth and a score or pv, past
+// "info string" lines and progress lines such as Stockfish's "info depth 20 currmove e2e4
+// currmovenumber 1", and records its fields. Everything after pv is moves
+void Engine::record_search(std::string_view out, size_t bestmove)
+{
+    std::string_view line;
+
+    for (size_t end = out.rfind('\n', bestmove); end != std::string_view::npos && end > 0 && line.empty();)
+    {
+        size_t begin = out.rfind('\n', end - 1);
+        size_t from  = begin == std::string_view::npos ? 0 : begin + 1;
+
+        std::string_view candidate = out.substr(from, end - from), rest = candidate;
+
+        if (   next_token(rest) == "info" && next_token(rest) != "string"
+            && candidate.find(" depth") != std::string_view::npos
+            && candidate.find(" currmove") == std::string_view::npos
+            && (candidate.find(" score") != std::string_view::npos || candidate.find(" pv") != std::string_view::npos))
+            line = candidate;
+
+        end = begin;
+    }
+
+    enum { DEPTH, SELDEPTH, NODES, NPS, HASHFULL, TIME, FIELDS };
+
+    const char *keys[FIELDS] = { "depth", "seldepth", "nodes", "nps", "hashfull", "time" };
+    uint64_t    values[FIELDS];
+    bool        found[FIELDS] = {};
+
+    next_token(line);
+
+    for (std::string_view key = next_token(line); !key.empty() && key != "pv" && key != "string"; key = next_token(line))
+        for (int i = 0; i < FIELDS; i++)
+            if (key == keys[i])
+            {
+                std::string_view value = next_token(line);
+                found[i] = std::from_chars(value.data(), value.data() + value.size(), values[i]).ec == std::errc();
+                break;
+            }
+
+    if (!found[NPS] && found[NODES] && found[TIME] && values[TIME])
+    {
+        values[NPS] = values[NODES] * 1000 / values[TIME];
+        found[NPS]  = true;
+    }
+
+    SearchStat *stats[FIELDS] = { &search.depth, &search.seldepth, &search.nodes, &search.nps, &search.hashfull, &search.time };
+
+    for (int i = 0; i < FIELDS; i++)
+        if (found[i])
+            stats[i]->record(values[i]);
+}
+
+void Engine::queue(const std::string& message)
+{
+    std::lock_guard<std::mutex> lock(m_write_mtx);
+    m_outgoing += message;
+}
+
+void Engine::write_to_stdin(const std::string& message)
+{
+    queue(message);
+
+    if (replay)
+        replay_input();
+    else
+        m_write_cv.notify_one();
+}
+
+void Engine::set_game(const std::string& game)
+{
+    m_game = game;
+
+    if (m_recorder)
+        m_recorder->record(REC_GAME, game.data(), game.size());
+}
+
+// Answers what was written from the recordings instead of a process: readyok to isready, and
+// to go what was recorded after the last position command
+void Engine::replay_input()
+{
+    std::string input;
+
+    {
+        std::lock_guard<std::mutex> lock(m_write_mtx);
+        input.swap(m_outgoing);
+        m_written = std::chrono::steady_clock::now();
+    }
+
+    for (size_t pos = 0, end; pos < input.size(); pos = end + 1)
+    {
+        end = std::min(input.find('\n', pos), input.size());
+
+        std::string_view line(input.data() + pos, end - pos);
+
+        if (line.rfind("position ", 0) == 0)
+            m_position = line;
+        else if (line == "isready")
+            m_replayed.push_back({ 0, "readyok\n" });
+        else if (line.rfind("go", 0) == 0)
+        {
+            const Replay::Answer *answer = replay->answer(m_name, m_game, m_position);
+
+            m_replay_end = answer ? answer->end : REC_EXIT;
+            m_unrecorded = !answer;
+
+            if (answer)
+                m_replayed.insert(m_replayed.end(), answer->chunks.begin(), answer->chunks.end());
+        }
+    }
+}
+
+// Writes everything queued since the last write in one WriteFile. No FlushFileBuffers: on a
+// pipe it waits until the engine has read the data, which is what this thread is there to avoid
+void Engine::write_loop()
+{
+    std::string buffer;
+    std::unique_lock<std::mutex> lock(m_write_mtx);
+
+    while (true)
+    {
+        m_write_cv.wait(lock, [&]() { return m_write_quit || !m_outgoing.empty(); });
+
+        if (m_outgoing.empty())
+            return;
+
+        buffer.clear();
+        buffer.swap(m_outgoing);
+
+        lock.unlock();
+
+        // Before the write, the answer may be read and recorded before WriteFile returns
+        if (m_recorder)
+            m_recorder->record(REC_INPUT, buffer.data(), buffer.size());
+
+        // Stamped before the write: the engine may answer, and best_move() read the answer,
+        // before WriteFile returns and this thread gets the lock back
+        auto  started = std::chrono::steady_clock::now();
+        DWORD written;
+
+        for (size_t pos = 0; pos < buffer.size(); pos += written)
+            if (!WriteFile(m_stdin, buffer.data() + pos, buffer.size() - pos, &written, NULL))
+                break;
+
+        lock.lock();
+
+        m_written = started;
+    }
+}
+
+// Appends what the engine wrote to out, false once its stdout is closed
+bool Engine::read_stdout(std::string& out)
+{
+    const int bufferSize = 65536;
+    char      buffer[bufferSize];
+    DWORD     read, available = 0;
+
+    // A recorded answer ends like the recording did, with bestmove, a closed stdout or a timeout
+    if (replay)
+    {
+        if (m_replayed.empty())
+        {
+            if (m_replay_end == REC_TIMEOUT)
+                m_timed_out = true;
+
+            return false;
+        }
+
+        if (replay->speed > 0)
+            std::this_thread::sleep_for(std::chrono::microseconds(uint64_t(m_replayed.front().delay / replay->speed)));
+
+        out += m_replayed.front().data;
+        m_replayed.pop_front();
+
+        return true;
+    }
+
+    // Yielding rather than pausing hands the core to the engine when there is no idle one
+    if (low_latency)
+        while (PeekNamedPipe(m_stdout, NULL, 0, NULL, &available, NULL) && !available)
+            std::this_thread::yield();
+
+    if (!ReadFile(m_stdout, buffer, bufferSize, &read, NULL) || read == 0)
+    {
+        if (m_recorder)
+            m_recorder->record(REC_EXIT);
+
+        return false;
+    }
+
+    if (m_recorder)
+        m_recorder->record(REC_OUTPUT, buffer, read);
+
+    out.append(buffer, read);
+
+    return true;
+}
+
+Engine::Engine(const std::string& path, int thinktime, int id) : m_stdin    (NULL),
+                                                                 m_stdout   (NULL),
+                                                                 m_process  (NULL),
+                                                                 m_job      (NULL),
+                                                                 m_timed_out(false),
+                                                                 m_error    (ENGINE_OK),
+                                                                 m_usage    (),
+                                                                 m_thinktime(thinktime),
+                                                                 wins       (0),
+                                                                 m_score    (0),
+                                                                 m_overshoot(0),
+                                                                 m_id       (id),
+                                                                 m_path     (path),
+                                                                 m_go_command("go movetime " + std::to_string(thinktime) + "\n"),
+                                                                 m_write_quit(false),
+                                                                 m_unrecorded(false)
+{
+    m_name    = engine_name(path);
+    m_metrics = &::metrics().engine(m_name);
+
+    //log.open(std::string("logs\\")+m_name+"_id"+std::to_string(m_id)+".txt");
+
+    if (!record_dir.empty() && !replay)
+        m_recorder = std::make_unique<Recorder>(record_dir+"\\"+m_name+"_id"+std::to_string(m_id)+"_"+std::to_string(recordings++)+".rec", !low_latency);
+
+    spawn();
+}
+
+void Engine::spawn()
+{
+    // Nothing to start, kill() and usage() see no process
+    if (replay)
+    {
+        m_replayed.clear();
+        m_replay_end = REC_EXIT;
+        m_unrecorded = false;
+        return;
+    }
+
+    PROCESS_INFORMATION piProcInfo;
+    STARTUPINFO siStartInfo;
+    SECURITY_ATTRIBUTES saAttr;
+    JOBOBJECT_EXTENDED_LIMIT_INFORMATION jobLimits;
+
+    ZeroMemory(&piProcInfo, sizeof(PROCESS_INFORMATION));
+    ZeroMemory(&siStartInfo, sizeof(STARTUPINFO));
+    ZeroMemory(&jobLimits, sizeof(JOBOBJECT_EXTENDED_LIMIT_INFORMATION));
+    siStartInfo.cb = sizeof(STARTUPINFO);
+    saAttr.nLength = sizeof(SECURITY_ATTRIBUTES);
+    saAttr.bInheritHandle = TRUE;
+    saAttr.lpSecurityDescriptor = NULL;
+
+    HANDLE hChildStdoutWr, hChildStdinRd;
+    DWORD  pipeSize = low_latency ? 1 << 20 : 0;
+
+    if (!CreatePipe(&m_stdout, &hChildStdoutWr, &saAttr, pipeSize) ||
+        !SetHandleInformation(m_stdout, HANDLE_FLAG_INHERIT, 0)    ||
+        !CreatePipe(&hChildStdinRd, &m_stdin, &saAttr, pipeSize)   ||
+        !SetHandleInformation(m_stdin, HANDLE_FLAG_INHERIT, 0))
+    {
+        std::cerr << "Error creating pipes." << std::endl;
+        std::exit(1);
+    }
+
+    siStartInfo.hStdError = hChildStdoutWr;
+    siStartInfo.hStdOutput = hChildStdoutWr;
+    siStartInfo.hStdInput = hChildStdinRd;
+    siStartInfo.dwFlags |= STARTF_USESTDHANDLES;
+
+    // The engine and everything it starts live in one job, so terminating the job
+    // takes down the whole process tree, and closing our handle to it does the same
+
+    jobLimits.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+
+    if (limits.memory_mb)
+    {
+        jobLimits.BasicLimitInformation.LimitFlags |= JOB_OBJECT_LIMIT_PROCESS_MEMORY;
+        jobLimits.ProcessMemoryLimit = limits.memory_mb << 20;
+    }
+
+    if (limits.cpu_seconds)
+    {
+        jobLimits.BasicLimitInformation.LimitFlags |= JOB_OBJECT_LIMIT_PROCESS_TIME;
+        jobLimits.BasicLimitInformation.PerProcessUserTimeLimit.QuadPart = limits.cpu_seconds * 10000000;
+    }
+
+    m_job = CreateJobObject(NULL, NULL);
+
+    if (!m_job || !SetInformationJobObject(m_job, JobObjectExtendedLimitInformation, &jobLimits, sizeof(jobLimits)))
+    {
+        std::cerr << "Error creating job object." << std::endl;
+        std::exit(1);
+    }
+
+    int len = strlen(m_path.c_str()) + 1;
+    LPWSTR wexe = new WCHAR[len];
+    MultiByteToWideChar(CP_ACP, 0, m_path.c_str(), -1, wexe, len);
+
+    if (!CreateProcess(NULL, wexe, NULL, NULL, TRUE, CREATE_SUSPENDED, NULL, NULL, &siStartInfo, &piProcInfo))
+    {
+        std::cerr << "CreateProcess failed." << std::endl;
+        std::exit(1);
+    }
+
+    delete[] wexe;
+
+    AssignProcessToJobObject(m_job, piProcInfo.hProcess);
+    ResumeThread(piProcInfo.hThread);
+
+    m_process = piProcInfo.hProcess;
+
+    if (m_recorder)
+        m_recorder->record(REC_SPAWN, m_path.data(), m_path.size());
+
+    CloseHandle(piProcInfo.hThread);
+    CloseHandle(hChildStdoutWr);
+    CloseHandle(hChildStdinRd);
+
+    m_write_quit = false;
+    m_writer     = std::thread(&Engine::write_loop, this);
+}
@@ -1,34 +1,274 @@
-
-#ifndef ENGINE_H
-#define ENGINE_H
-
-#include <string>
-#include <windows.h>
-#include <fstream>
-
-class Engine
-{
-public:
-    Engine(const std::string &path, int thinktime, int id);
-   ~Engine() { kill(); }
-
-    void write_to_stdin(const std::string& message);
-    void kill() { log.close(); write_to_stdin("stop\nquit\n"); }
-    std::string read_stdout();
-    std::string best_move();
-    std::string name() const { return m_name; }
-
-    int wins;
-
-private:
-    std::ofstream log;
-
-    int    m_thinktime;
-    int    m_id;
-    HANDLE m_stdin;
-    HANDLE m_stdout;
-
-    std::string m_name;
-};
-
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <windows.h>
+#include <fstream>
+
+#include "histogram.h"
+#include "metrics.h"
+#include "recording.h"
+#include "stats.h"
+#include "types.h"
+
+inline std::string engine_name(const std::string& path)
+{
+    std::string relative_path = path.find('\\') == std::string::npos ? path : path.substr(path.rfind('\\') + 1);
+    return relative_path.substr(0, relative_path.find(".exe"));
+}
+
+// Microseconds per move, measured with a monotonic clock
+struct MoveTimes
+{
+    Histogram think;       // 'go' written until the 'bestmove' line was read
+    Histogram overshoot;   // think time beyond movetime
+    Histogram turnaround;  // 'bestmove' read until the manager wrote the next 'go'
+    Histogram cpu_load;    // CPU time of the engine process / think time, in percent
+
+    void merge(const MoveTimes& t)
+    {
+        think.merge(t.think);
+        overshoot.merge(t.overshoot);
+        turnaround.merge(t.turnaround);
+        cpu_load.merge(t.cpu_load);
+    }
+
+    void clear()
+    {
+        think.clear();
+        overshoot.clear();
+        turnaround.clear();
+        cpu_load.clear();
+    }
+
+    void print(const std::string& name) const
+    {
+        think.print((name + " think").c_str(), "us");
+        overshoot.print((name + " overshoot").c_str(), "us");
+        turnaround.print((name + " turnaround").c_str(), "us");
+        cpu_load.print((name + " cpu/wall").c_str(), "%");
+    }
+};
+
+// One field of the engines' info lines: percentiles from the histogram, mean and variance from the moments
+struct SearchStat
+{
+    Histogram    hist;
+    RunningStats moments;
+
+    void record(uint64_t v)
+    {
+        hist.record(v);
+        moments.record(double(v));
+    }
+
+    void merge(const SearchStat& s)
+    {
+        hist.merge(s.hist);
+        moments.merge(s.moments);
+    }
+
+    void clear()
+    {
+        hist.clear();
+        moments = RunningStats();
+    }
+
+    void print(const char *label) const
+    {
+        printf("%-24s n=%-9llu mean %10.1f  sd %10.1f  p10 %9llu  p50 %9llu  p90 %9llu  max %9llu\n",
+               label, (unsigned long long)hist.count(), moments.mean, moments.stddev(),
+               (unsigned long long)hist.percentile(10), (unsigned long long)hist.percentile(50),
+               (unsigned long long)hist.percentile(90), (unsigned long long)hist.max());
+    }
+};
+
+// What the engine reported in the last info line with a depth before each bestmove. Fields
+// missing from that line are not recorded, except nps, which is taken from nodes and time
+struct SearchStats
+{
+    SearchStat depth;
+    SearchStat seldepth;
+    SearchStat nodes;
+    SearchStat nps;
+    SearchStat hashfull;  // permille
+    SearchStat time;      // milliseconds, as reported by the engine
+
+    void merge(const SearchStats& s)
+    {
+        depth.merge(s.depth);
+        seldepth.merge(s.seldepth);
+        nodes.merge(s.nodes);
+        nps.merge(s.nps);
+        hashfull.merge(s.hashfull);
+        time.merge(s.time);
+    }
+
+    void clear()
+    {
+        depth.clear();
+        seldepth.clear();
+        nodes.clear();
+        nps.clear();
+        hashfull.clear();
+        time.clear();
+    }
+
+    void print(const std::string& name) const
+    {
+        const std::pair<const char*, const SearchStat*> fields[] = {
+            { " depth", &depth }, { " seldepth", &seldepth }, { " nodes", &nodes },
+            { " nps", &nps }, { " hashfull", &hashfull }, { " time ms", &time } };
+
+        for (const auto& [label, stat] : fields)
+            if (stat->hist.count())
+                stat->print((name + label).c_str());
+    }
+};
+
+// Totals over all processes started for an engine. Peaks are the largest of any single process
+struct ResourceUsage
+{
+    double   user_seconds;
+    double   kernel_seconds;
+    uint64_t peak_working_set;
+    uint64_t peak_commit;
+    uint64_t page_faults;
+    int      processes;
+
+    void merge(const ResourceUsage& u)
+    {
+        user_seconds    += u.user_seconds;
+        kernel_seconds  += u.kernel_seconds;
+        peak_working_set = std::max(peak_working_set, u.peak_working_set);
+        peak_commit      = std::max(peak_commit, u.peak_commit);
+        page_faults     += u.page_faults;
+        processes       += u.processes;
+    }
+
+    void print(const std::string& name) const
+    {
+        printf("%-24s cpu user %.1f s kernel %.1f s, peak working set %.1f MB, peak commit %.1f MB, %llu page faults, %d processes\n",
+               name.c_str(), user_seconds, kernel_seconds, peak_working_set / 1048576.0, peak_commit / 1048576.0,
+               (unsigned long long)page_faults, processes);
+    }
+};
+
+// ENGINE_NOT_RECORDED: with --replay, the engine has no recorded answer in the position
+enum EngineError { ENGINE_OK, ENGINE_ILLEGAL_MOVE, ENGINE_TIMEOUT, ENGINE_CRASH, ENGINE_NOT_RECORDED };
+
+// Limits applied to every engine process. A move that takes longer than movetime + grace_ms
+// is a time loss; memory_mb and cpu_seconds are per process caps enforced by the job object
+struct EngineLimits
+{
+    int      grace_ms    = 1000;
+    uint64_t memory_mb   = 0;
+    uint64_t cpu_seconds = 0;
+};
+
+class Engine
+{
+public:
+    Engine(const std::string &path, int thinktime, int id);
+   ~Engine() { kill(); }
+
+    // Commands are only queued here and written by the engine's own writer thread, so an
+    // engine that is slow to read its input never stalls the game. queue() holds the command
+    // back until the next write_to_stdin(), and both go out in one write
+    void write_to_stdin(const std::string& message);
+    void queue(const std::string& message);
+    void kill();
+    void handshake();
+    void sync(const std::string& commands);  // writes commands and isready, and waits for readyok
+    void restart() { kill(); spawn(); handshake(); }
+    void terminate();
+    bool read_stdout(std::string& out);
+    std::string best_move();
+    void set_go(const std::string& command) { m_go_command = command + "\n"; }
+    void set_game(const std::string& game);  // names the game that starts, for --record and --replay
+    const std::string& output() const { return m_output; }  // everything read for the last best_move()
+    std::string name() const { return m_name; }
+    int score() const { return m_score; }
+    int64_t overshoot() const { return m_overshoot; }
+    EngineError error() const { return m_error; }
+    ResourceUsage usage() const;
+    EngineMetrics& metrics() const { return *m_metrics; }
+
+    std::chrono::steady_clock::time_point go_time() const { return m_go; }
+    std::chrono::steady_clock::time_point bestmove_time() const { return m_bestmove; }
+
+    inline static EngineLimits limits;
+
+    // For movetimes of a few milliseconds: 1 MB pipes, and reads spin on the pipe instead of
+    // blocking, which keeps one core per thread busy but answers a bestmove without a wakeup
+    inline static bool low_latency = false;
+
+    // --record writes a recording of every engine to this directory. With --replay set, no
+    // process is started and every 'go' is answered from the recordings
+    inline static std::string record_dir;
+    inline static Replay     *replay = nullptr;
+
+    int         wins;
+    MoveTimes   times;
+    SearchStats search;
+
+private:
+    void spawn();
+    void write_loop();
+    void replay_input();
+    void record_search(std::string_view out, size_t bestmove);
+
+    std::ofstream log;
+
+    int     m_thinktime;
+    int     m_id;
+    int     m_score;
+    int64_t m_overshoot;
+    HANDLE  m_stdin;
+    HANDLE  m_stdout;
+    HANDLE  m_process;
+    HANDLE  m_job;
+
+    std::atomic<bool> m_timed_out;
+    EngineError       m_error;
+    ResourceUsage     m_usage;
+    EngineMetrics    *m_metrics;
+
+    uint64_t cpu_time() const;
+
+    std::string m_path;
+    std::string m_name;
+    std::string m_go_command;
+    std::string m_output;
+
+    std::mutex              m_write_mtx;
+    std::condition_variable m_write_cv;
+    std::string             m_outgoing;
+    bool                    m_write_quit;
+    std::thread             m_writer;
+
+    std::chrono::steady_clock::time_point m_written;  // last write to stdin started
+
+    std::unique_ptr<Recorder>  m_recorder;
+    std::deque<Replay::Chunk>  m_replayed;    // answer to the last 'go' not read yet
+    RecordType                 m_replay_end;  // what a read after the answer gets
+    std::string                m_position;    // last position command
+    std::string                m_game;        // from set_game()
+    bool                       m_unrecorded;  // the last 'go' had no recorded answer
+
+    std::chrono::steady_clock::time_point m_go;
+    std::chrono::steady_clock::time_point m_bestmove;
+};
+
 #endif
\ No newline at end of file
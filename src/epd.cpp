@@ -0,0 +1,353 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define NOMINMAX
+
+#include "epd.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <windows.h>
+
+#include "bitboard.h"
+#include "engine.h"
+#include "histogram.h"
+#include "misc.h"
+#include "results.h"
+#include "uci.h"
+
+namespace {
+
+std::string_view next_token(std::string_view& s)
+{
+    size_t begin = std::min(s.size(), s.find_first_not_of(" \t\r\n"));
+    size_t end   = std::min(s.size(), s.find_first_of(" \t\r\n", begin));
+
+    std::string_view token = s.substr(begin, end - begin);
+    s.remove_prefix(end);
+
+    return token;
+}
+
+bool is_number(std::string_view s)
+{
+    return !s.empty() && std::all_of(s.begin(), s.end(), [](char c) { return c >= '0' && c <= '9'; });
+}
+
+// Everything one thread found for one engine, merged into the totals at the end
+struct EpdTotals
+{
+    uint64_t  tried  = 0;
+    uint64_t  solved = 0;
+    uint64_t  failed = 0;  // timeouts and crashes
+    Histogram time_ms;
+    Histogram nodes;
+
+    void merge(const EpdTotals& t)
+    {
+        tried  += t.tried;
+        solved += t.solved;
+        failed += t.failed;
+        time_ms.merge(t.time_ms);
+        nodes.merge(t.nodes);
+    }
+};
+
+}
+
+bool EpdPosition::solution(Move m) const
+{
+    return (best.empty() || std::find(best.begin(), best.end(), m) != best.end())
+        && std::find(avoid.begin(), avoid.end(), m) == avoid.end();
+}
+
+std::vector<EpdPosition> load_epd(const std::string& path)
+{
+    std::ifstream            in(path);
+    std::vector<EpdPosition> positions;
+    std::string              line;
+    Position                 pos;
+
+    for (int number = 1; std::getline(in, line); number++)
+    {
+        std::string_view rest(line), fields[4];
+
+        for (std::string_view& field : fields)
+            field = next_token(rest);
+
+        if (fields[3].empty())
+            continue;
+
+        EpdPosition p;
+
+        p.id  = path + ":" + std::to_string(number);
+        p.fen = std::string(fields[0]) + " " + std::string(fields[1]) + " " + std::string(fields[2]) + " " + std::string(fields[3]) + " 0 1";
+
+        // Move generation needs both kings
+        bool legal = pos.set(p.fen) && popcount(pos.bb(W_KING)) == 1 && popcount(pos.bb(B_KING)) == 1;
+
+        // Operations end with ';'. A halfmove clock and move number after the fields are skipped
+        for (size_t end; legal && !rest.empty(); rest.remove_prefix(end))
+        {
+            end = rest.find(';') == std::string_view::npos ? rest.size() : rest.find(';') + 1;
+
+            std::string_view op = rest.substr(0, end - (rest[end - 1] == ';')), opcode = next_token(op);
+
+            while (is_number(opcode))
+                opcode = next_token(op);
+
+            if (opcode == "id")
+            {
+                size_t begin = std::min(op.size(), op.find_first_not_of(" \t\"")), last = op.find_last_not_of(" \t\r\"");
+                p.id = last == std::string_view::npos || last < begin ? p.id : std::string(op.substr(begin, last + 1 - begin));
+            }
+            else if (opcode == "bm" || opcode == "am")
+                for (std::string_view text = next_token(op); !text.empty() && legal; text = next_token(op))
+                {
+                    Move m = san_to_move(text, pos);
+
+                    if (m == Move::null())
+                        m = uci_to_move(text, pos);
+
+                    legal = m != Move::null();
+                    (opcode == "bm" ? p.best : p.avoid).push_back(m);
+                }
+        }
+
+        if (!legal)
+            std::cout << "Skipping " << p.id << ", not a legal position and move: " << line << std::endl;
+        else if (p.best.empty() && p.avoid.empty())
+            std::cout << "Skipping " << p.id << ", it has no bm or am" << std::endl;
+        else
+            positions.push_back(std::move(p));
+    }
+
+    return positions;
+}
+
+EpdResult judge(const EpdPosition& p, const Position& pos, std::string_view output, Move bestmove, uint64_t think_ms)
+{
+    EpdResult result  = { p.solution(bestmove), think_ms, 0 };
+    bool      holding = false;
+
+    while (!output.empty())
+    {
+        size_t           end  = std::min(output.size(), output.find('\n'));
+        std::string_view line = output.substr(0, end), key = next_token(line);
+
+        output.remove_prefix(std::min(output.size(), end + 1));
+
+        if (key == "bestmove")
+            break;
+
+        if (key != "info")
+            continue;
+
+        uint64_t         time = think_ms, nodes = 0;
+        std::string_view pv;
+        bool             first = true;
+
+        for (key = next_token(line); !key.empty() && key != "string" && pv.empty(); key = next_token(line))
+        {
+            std::string_view value = key == "time" || key == "nodes" || key == "pv" || key == "multipv" ? next_token(line) : std::string_view();
+
+            if (key == "time")
+                std::from_chars(value.data(), value.data() + value.size(), time);
+            else if (key == "nodes")
+                std::from_chars(value.data(), value.data() + value.size(), nodes);
+            else if (key == "pv")
+                pv = value;
+            else if (key == "multipv")
+                first = value == "1";
+        }
+
+        // With MultiPV only the first line is the move the engine would play
+        if (pv.empty() || !first)
+            continue;
+
+        if (!p.solution(uci_to_move(pv, pos)))
+            holding = false;
+        else if (!holding)
+        {
+            holding        = true;
+            result.time_ms = time;
+            result.nodes   = nodes;
+        }
+    }
+
+    // The last pv that counts is the bestmove, which may differ from the pv before it
+    if (!result.solved || !holding)
+        result = { result.solved, think_ms, 0 };
+
+    return result;
+}
+
+bool run_epd(const std::string& path, const std::vector<std::string>& engines, int time, uint64_t nodes, int threads,
+             const std::string& results, Control *control)
+{
+    std::vector<EpdPosition> positions = load_epd(path);
+
+    if (positions.empty())
+    {
+        std::cout << "No positions found in " << path << std::endl;
+        return false;
+    }
+
+    std::string go = nodes ? "go nodes " + std::to_string(nodes) : "go movetime " + std::to_string(time);
+
+    std::cout << positions.size() << " positions from " << path << ", " << engines.size() << " engines, " << go << ", " << threads << " threads" << std::endl;
+
+    std::vector<EngineSummary> summaries;
+    std::vector<EpdTotals>     totals(engines.size());
+    std::mutex                 mtx;
+
+    for (const std::string& engine : engines)
+        summaries.push_back({ engine_name(engine) });
+
+    std::atomic<size_t> next = 0, done = 0;
+
+    auto progress = [&]() {
+        std::lock_guard<std::mutex> lock(mtx);
+        printf("%s %zu/%zu positions\n", time_().c_str(), std::min(done.load(), positions.size()), positions.size());
+    };
+
+    control->set_stats(progress);
+
+    std::vector<std::thread> thread_pool;
+
+    for (int id = 0; id < threads; id++)
+        thread_pool.emplace_back([&, id]() {
+            std::vector<std::unique_ptr<Engine>> slot;
+            std::vector<EpdTotals>               found(engines.size());
+
+            // --time bounds a node limited search too, it is what the watchdog allows before a timeout
+            for (const std::string& engine : engines)
+            {
+                slot.push_back(std::make_unique<Engine>(engine, time, id));
+                slot.back()->set_go(go);
+                slot.back()->handshake();
+            }
+
+            std::ofstream log("logs\\epd_id" + std::to_string(id) + ".txt");
+            Position      pos;
+
+            for (size_t i; control->next_game(id) && (i = next++) < positions.size(); done++)
+            {
+                const EpdPosition& p = positions[i];
+
+                pos.set(p.fen);
+
+                for (size_t e = 0; e < slot.size(); e++)
+                {
+                    Engine& engine = *slot[e];
+
+                    engine.set_game(p.id);
+                    engine.sync("ucinewgame\n");
+                    engine.queue("position fen " + p.fen + "\n");
+
+                    std::string bestmove = engine.best_move();
+                    uint64_t    think    = std::chrono::duration_cast<std::chrono::milliseconds>(engine.bestmove_time() - engine.go_time()).count();
+
+                    // A replay error is no failure of the engine, the position is left out
+                    if (engine.error() == ENGINE_NOT_RECORDED)
+                    {
+                        log << p.id << " " << engine.name() << " not recorded" << std::endl;
+                        continue;
+                    }
+
+                    found[e].tried++;
+
+                    if (engine.error() != ENGINE_OK)
+                    {
+                        log << p.id << " " << engine.name() << (engine.error() == ENGINE_TIMEOUT ? " timeout" : " crash") << std::endl;
+
+                        found[e].failed++;
+                        engine.restart();
+                        continue;
+                    }
+
+                    EpdResult r = judge(p, pos, engine.output(), uci_to_move(bestmove, pos), think);
+
+                    log << p.id << " " << engine.name() << " " << bestmove << (r.solved ? " solved " : " unsolved ")
+                        << r.time_ms << " ms " << r.nodes << " nodes" << std::endl;
+
+                    if (r.solved)
+                    {
+                        found[e].solved++;
+                        found[e].time_ms.record(r.time_ms);
+
+                        if (r.nodes)
+                            found[e].nodes.record(r.nodes);
+                    }
+                }
+            }
+
+            for (auto& engine : slot)
+                engine->kill();
+
+            std::lock_guard<std::mutex> lock(mtx);
+
+            for (size_t e = 0; e < slot.size(); e++)
+            {
+                totals[e].merge(found[e]);
+                summaries[e].times.merge(slot[e]->times);
+                summaries[e].search.merge(slot[e]->search);
+                summaries[e].usage.merge(slot[e]->usage());
+            }
+        });
+
+    for (uint64_t last = unix_ms(); done < positions.size() && !control->quitting() && !control->draining(); Sleep(100))
+        if (unix_ms() - last >= 5000)
+        {
+            progress();
+            last = unix_ms();
+        }
+
+    for (std::thread& thread : thread_pool)
+        thread.join();
+
+    control->set_stats(nullptr);
+
+    printf("\n");
+
+    for (size_t e = 0; e < engines.size(); e++)
+    {
+        const EpdTotals& t = totals[e];
+
+        printf("%-24s solved %llu/%llu (%.1f%%)", summaries[e].name.c_str(), (unsigned long long)t.solved, (unsigned long long)t.tried,
+               100.0 * t.solved / std::max<uint64_t>(1, t.tried));
+
+        if (t.failed)
+            printf(", %llu timeouts or crashes", (unsigned long long)t.failed);
+
+        printf("\n");
+
+        summaries[e].tried       = t.tried;
+        summaries[e].solved      = t.solved;
+        summaries[e].failed      = t.failed;
+        summaries[e].solve_ms    = t.time_ms;
+        summaries[e].solve_nodes = t.nodes;
+    }
+
+    printf("\n");
+
+    for (size_t e = 0; e < engines.size(); e++)
+    {
+        totals[e].time_ms.print((summaries[e].name + " time to solution").c_str(), "ms");
+
+        if (totals[e].nodes.count())
+            totals[e].nodes.print((summaries[e].name + " nodes to solution").c_str(), "");
+    }
+
+    print_summary(summaries);
+
+    if (!results.empty() && !write_results(results, summaries))
+        std::cout << "Could not write " << results << std::endl;
+
+    return true;
+}
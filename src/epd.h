@@ -0,0 +1,46 @@
+
+#ifndef EPD_H
+#define EPD_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "control.h"
+#include "position.h"
+
+// A test position: the four FEN fields of an EPD line, and its bm (best moves) and am (moves
+// to avoid) operations. A move is a solution if it is one of the best moves, if there are
+// any, and none of the moves to avoid
+struct EpdPosition
+{
+    std::string       id;
+    std::string       fen;
+    std::vector<Move> best;
+    std::vector<Move> avoid;
+
+    bool solution(Move m) const;
+};
+
+// Positions without bm or am, and those whose moves are not legal, are reported and skipped
+std::vector<EpdPosition> load_epd(const std::string& path);
+
+struct EpdResult
+{
+    bool     solved;
+    uint64_t time_ms;  // time to solution
+    uint64_t nodes;    // nodes to solution, 0 if the engine did not report them
+};
+
+// Walks the info lines of one search: the solution time is that of the first pv from which
+// on every pv started with a solution, up to a bestmove that is one too. A solution found
+// without any pv, or in a line without time, counts as found at think_ms
+EpdResult judge(const EpdPosition& p, const Position& pos, std::string_view output, Move bestmove, uint64_t think_ms);
+
+// --epd: every engine searches every position with 'go movetime time', or 'go nodes nodes'
+// if nodes is set, on threads threads that each have a process of every engine
+bool run_epd(const std::string& path, const std::vector<std::string>& engines, int time, uint64_t nodes, int threads,
+             const std::string& results, Control *control);
+
+#endif
@@ -0,0 +1,199 @@
+
+#include "game.h"
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <vector>
+
+#include "uci.h"
+
+const char *termination_name(const GameResult& r)
+{
+    return r.error == ENGINE_TIMEOUT      ? "Time forfeit"
+         : r.error == ENGINE_CRASH        ? "Engine crash"
+         : r.error == ENGINE_ILLEGAL_MOVE ? "Illegal move"
+         : r.error == ENGINE_NOT_RECORDED ? "Not recorded"
+         : r.failed                       ? "Engine error"
+         : r.state == MATE                ? "Checkmate"
+         : r.state == STALEMATE           ? "Stalemate"
+         : r.state == REPETITION          ? "Repetition"
+         : r.state == FIFTY_MOVE          ? "Fifty-move rule" : "?";
+}
+
+namespace {
+
+// The position goes to the side to move in one write with its next 'go', and to the other
+// side right away so it can take it in while its opponent thinks
+void send_position(bool white_to_move, Engine& white, Engine& black, const std::string& position)
+{
+    Engine& to_move = white_to_move ? white : black;
+    Engine& waiting = white_to_move ? black : white;
+
+    to_move.queue(position);
+    waiting.write_to_stdin(position);
+}
+
+}
+
+OpeningOutcome opening_outcome(const GameResult& r)
+{
+    if (r.failed)
+        return { 0, r.winner == WHITE ? 1 : -1, ONGOING, r.exit_eval };
+
+    return { r.plies, r.state != MATE ? 0 : r.winner == WHITE ? 1 : -1, r.state, r.exit_eval };
+}
+
+void record_metrics(Engine& white, Engine& black, const GameResult& r)
+{
+    if (!r.decisive())
+    {
+        white.metrics().draws++;
+        black.metrics().draws++;
+        return;
+    }
+
+    EngineMetrics& winner = (r.winner == WHITE ? white : black).metrics();
+    EngineMetrics& loser  = (r.winner == WHITE ? black : white).metrics();
+
+    winner.wins++;
+    loser.losses++;
+
+    if (r.error == ENGINE_CRASH)
+        loser.crashes++;
+    else if (r.error == ENGINE_TIMEOUT)
+        loser.time_losses++;
+    else if (r.error == ENGINE_ILLEGAL_MOVE)
+        loser.illegal_moves++;
+}
+
+GameResult play_game(Engine& white, Engine& black, const std::string& fen, Control *control, std::ofstream& log, DataWriter *data, GameTimings *timings)
+{
+    using Clock = std::chrono::steady_clock;
+
+    auto micros = [](Clock::duration d) { return std::chrono::duration_cast<std::chrono::microseconds>(d).count(); };
+
+    Position pos;
+    pos.set(fen);
+
+    std::stringstream pgn;
+    std::string       uci = "position fen " + fen + "\n";
+
+    pgn << "[White \"" << white.name() << "\"]\n"
+        << "[Black \"" << black.name() << "\"]\n"
+        << "[FEN \"" << fen << "\"]\n";
+
+    if (pos.black_to_move()) pgn << "1... ";
+
+    // The side to move gets the position together with its first 'go'
+    send_position(pos.white_to_move(), white, black, "ucinewgame\n" + uci);
+
+    // With --low_latency the log goes out when the buffer fills or the game ends, not every move
+    uci.pop_back();
+    uci += " moves";
+    log << uci << " ";
+
+    if (!Engine::low_latency)
+        log.flush();
+
+    std::vector<PackedPos> game_data;
+    Clock::time_point      validated;
+    Engine                *last = nullptr;
+    int                    exit_eval = 0;
+
+    for (int pgn_num = 1, plies = 0; control->next_move(); plies++)
+    {
+        Engine& engine = pos.white_to_move() ? white : black;
+
+        Clock::time_point go = Clock::now();
+
+        std::string uci_move = engine.best_move();
+
+        Clock::time_point bestmove = Clock::now();
+
+        control->record_overshoot(engine.overshoot());
+
+        if (last)
+            last->times.turnaround.record(micros(engine.go_time() - last->bestmove_time()));
+
+        last = &engine;
+
+        // Mate scores are capped so that one does not outweigh every other game from the opening
+        if (plies < 2)
+            exit_eval += std::clamp(engine.score(), -1000, 1000) * (pos.white_to_move() ? 1 : -1);
+
+        Move move = uci_to_move(uci_move, pos);
+
+        if (timings)
+        {
+            if (plies)
+                timings->validated_to_go.record(micros(go - validated));
+
+            validated = Clock::now();
+
+            timings->go_to_bestmove.record(micros(bestmove - go));
+            timings->bestmove_to_validated.record(micros(validated - bestmove));
+        }
+
+        // A replayed engine that was not recorded in the position is not at fault, the game
+        // ends without a result
+        if (move == Move::null())
+        {
+            bool       failed = engine.error() != ENGINE_NOT_RECORDED;
+            GameResult r      = { ONGOING, failed, !pos.side_to_move(), plies,
+                                  engine.error() != ENGINE_OK ? engine.error() : ENGINE_ILLEGAL_MOVE };
+
+            pgn << (!failed ? "*" : pos.white_to_move() ? "0-1" : "1-0");
+
+            log << std::endl << pgn.str() 
+                << std::endl << pos.to_string()
+                << std::endl << engine.name() << ": " << uci_move << " <- " << termination_name(r);
+
+            return r;
+        }
+
+        if (data)
+            game_data.push_back(pack(pos, engine.score(), plies));
+
+        if (pos.white_to_move())
+            pgn << pgn_num << ". ";
+        pgn << move_to_san(move, pos) << " ";
+        if (pos.black_to_move())
+            pgn_num++;
+
+        log << uci_move << " ";
+
+        if (!Engine::low_latency)
+            log.flush();
+
+        pos.do_move(move);
+
+        uci += " " + uci_move + "\n";
+        send_position(pos.white_to_move(), white, black, uci);
+        uci.pop_back();
+
+        if (GameState g = pos.game_state(); g != ONGOING)
+        {
+            pgn << (g != MATE ? "1/2-1/2" : pos.white_to_move() ? "0-1" : "1-0");
+
+            if (data)
+            {
+                uint8_t result = g != MATE ? DRAW_RESULT : pos.white_to_move() ? BLACK_WIN : WHITE_WIN;
+
+                for (PackedPos& p : game_data)
+                    p.result = result;
+
+                data->write(game_data.data(), game_data.size());
+            }
+
+            GameResult r = { g, false, !pos.side_to_move(), plies + 1, ENGINE_OK, exit_eval / std::min(plies + 1, 2) };
+
+            log << std::endl << pgn.str() 
+                << std::endl << termination_name(r);
+
+            return r;
+        }
+    }
+
+    return { ONGOING, false, WHITE, 0, ENGINE_OK };
+}
@@ -0,0 +1,54 @@
+
+#ifndef GAME_H
+#define GAME_H
+
+#include <fstream>
+#include <string>
+
+#include "control.h"
+#include "datagen.h"
+#include "engine.h"
+#include "histogram.h"
+#include "openings.h"
+#include "position.h"
+
+struct GameResult
+{
+    GameState   state;
+    bool        failed;
+    Color       winner;
+    int         plies;
+    EngineError error;
+    int         exit_eval = 0;  // centipawns for white, the average of both engines' first score
+
+    bool decisive() const { return state == MATE || failed; }
+    bool aborted() const { return state == ONGOING && !failed; }
+};
+
+// Per-move manager latencies in microseconds: from sending 'go' until bestmove was read,
+// from bestmove until the move was checked for legality, and from there until the next 'go'
+struct GameTimings
+{
+    Histogram go_to_bestmove;
+    Histogram bestmove_to_validated;
+    Histogram validated_to_go;
+
+    void merge(const GameTimings& t)
+    {
+        go_to_bestmove.merge(t.go_to_bestmove);
+        bestmove_to_validated.merge(t.bestmove_to_validated);
+        validated_to_go.merge(t.validated_to_go);
+    }
+};
+
+const char *termination_name(const GameResult& r);
+
+// For the opening history; plies is 0 for a game that did not end on the board
+OpeningOutcome opening_outcome(const GameResult& r);
+
+// Adds a scored game to the live metrics of both engines
+void record_metrics(Engine& white, Engine& black, const GameResult& r);
+
+GameResult play_game(Engine& white, Engine& black, const std::string& fen, Control *control, std::ofstream& log, DataWriter *data = nullptr, GameTimings *timings = nullptr);
+
+#endif
@@ -0,0 +1,270 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define NOMINMAX
+
+#include "genbook.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include <windows.h>
+
+#include "bitboard.h"
+#include "misc.h"
+#include "openings.h"
+#include "position.h"
+
+KeySet::KeySet(uint64_t capacity)
+{
+    uint64_t size = 1024;
+
+    while (size < capacity)
+        size *= 2;
+
+    slots = std::make_unique<std::atomic<uint64_t>[]>(size);
+    mask  = size - 1;
+
+    for (uint64_t i = 0; i < size; i++)
+        slots[i].store(0, std::memory_order_relaxed);
+}
+
+bool KeySet::insert(uint64_t key)
+{
+    key = key ? key : 1;
+
+    // Zobrist keys are uniform, so the low bits are the slot and linear probing stays short
+    for (uint64_t i = key & mask, probes = 0; probes <= mask; i = (i + 1) & mask, probes++)
+    {
+        uint64_t current = slots[i].load(std::memory_order_relaxed);
+
+        if (current == key)
+            return false;
+
+        if (current == 0)
+        {
+            if (slots[i].compare_exchange_strong(current, key, std::memory_order_relaxed))
+                return true;
+
+            if (current == key)
+                return false;
+        }
+    }
+
+    return false;
+}
+
+namespace {
+
+constexpr Bitboard CENTER      = (FILE_C | FILE_D | FILE_E | FILE_F) & (RANK_3 | RANK_4 | RANK_5 | RANK_6);
+constexpr Bitboard CHECKERBOARD = 0x55aa55aa55aa55aaull;
+
+// No sequence of legal moves can mate: bare kings, one minor piece, or only bishops all on one color
+bool insufficient_material(const Position& pos)
+{
+    if (pos.bb(W_PAWN) | pos.bb(B_PAWN) | pos.bb(W_ROOK) | pos.bb(B_ROOK) | pos.bb(W_QUEEN) | pos.bb(B_QUEEN))
+        return false;
+
+    Bitboard knights = pos.bb(W_KNIGHT) | pos.bb(B_KNIGHT);
+    Bitboard bishops = pos.bb(W_BISHOP) | pos.bb(B_BISHOP);
+
+    return popcount(knights | bishops) <= 1 || (!knights && (!(bishops & CHECKERBOARD) || !(bishops & ~CHECKERBOARD)));
+}
+
+int weight(const Position& pos, Move m)
+{
+    PieceType pt = pos.piece_type_on(m.from_sq());
+
+    if (m.type_of() == CASTLING)
+        return 3;
+
+    if (pos.piece_on(m.to_sq()) || m.type_of() == ENPASSANT)
+        return 4;
+
+    if (pt == KING)
+        return 1;
+
+    if (pt == PAWN || pt == KNIGHT || pt == BISHOP)
+        return square_bb(m.to_sq()) & CENTER ? 3 : 2;
+
+    return 2;
+}
+
+struct Counters
+{
+    std::atomic<uint64_t> claimed {};
+    std::atomic<uint64_t> playouts {};
+    std::atomic<uint64_t> decided {};
+    std::atomic<uint64_t> duplicates {};
+    std::atomic<int>      running {};
+};
+
+void generate(const std::vector<Position>& roots, uint64_t count, int min_plies, int max_plies, bool weighted,
+              KeySet& keys, Counters& counters, std::ofstream& out, std::mutex& out_mtx, Control *control)
+{
+    std::random_device rd;
+    std::mt19937_64    rng((uint64_t(rd()) << 32) | rd());
+    Position           pos;
+    std::string        buffer;
+    Move               list[MAX_MOVES];
+    int                weights[MAX_MOVES];
+    uint64_t           playouts = 0, decided = 0, duplicates = 0, stalled = 0;
+
+    auto flush = [&]() {
+        std::lock_guard<std::mutex> lock(out_mtx);
+        out << buffer;
+        buffer.clear();
+    };
+
+    // Quits when the book is full, or a million playouts in a row found nothing new
+    while (counters.claimed < count && stalled < 1000000 && !control->quitting())
+    {
+        size_t root  = roots.size() > 1 ? rng() % roots.size() : 0;
+        int    plies = min_plies + rng() % (max_plies - min_plies + 1);
+        bool   over  = false;
+
+        pos = roots[root];
+        playouts++;
+        stalled++;
+
+        for (int ply = 0; ply < plies && !over; ply++)
+        {
+            Move *end = pos.get_moves(list);
+            int   n   = end - list;
+
+            if (!n)
+            {
+                over = true;
+                break;
+            }
+
+            int i = 0;
+
+            if (weighted)
+            {
+                int total = 0;
+
+                for (int j = 0; j < n; j++)
+                    total += weights[j] = weight(pos, list[j]);
+
+                for (int r = rng() % total; r >= weights[i]; i++)
+                    r -= weights[i];
+            }
+            else
+                i = rng() % n;
+
+            pos.do_move(list[i]);
+        }
+
+        if (over || pos.game_state() != ONGOING || insufficient_material(pos))
+        {
+            decided++;
+            continue;
+        }
+
+        if (!keys.insert(pos.hash()))
+        {
+            duplicates++;
+            continue;
+        }
+
+        if (counters.claimed++ >= count)
+            break;
+
+        // The move number is counted from the root, which is taken to be at move 1
+        buffer += pos.fen() + " " + std::to_string(1 + (plies + roots[root].black_to_move()) / 2) + "\n";
+        stalled = 0;
+
+        if (buffer.size() >= 1 << 16)
+            flush();
+    }
+
+    flush();
+
+    counters.playouts   += playouts;
+    counters.decided    += decided;
+    counters.duplicates += duplicates;
+    counters.running--;
+}
+
+}
+
+bool run_genbook(const std::string& path, uint64_t count, int min_plies, int max_plies, const std::string& seeds, bool weighted,
+                 int threads, Control *control)
+{
+    build_slider_tables();
+
+    std::vector<Position> roots(1);
+
+    if (!seeds.empty())
+    {
+        std::vector<std::string> fens = load_openings(seeds, std::thread::hardware_concurrency());
+
+        if (fens.empty())
+        {
+            std::cout << "No positions found in " << seeds << std::endl;
+            return false;
+        }
+
+        roots.resize(fens.size());
+
+        for (size_t i = 0; i < fens.size(); i++)
+            roots[i].set(fens[i]);
+    }
+
+    std::ofstream out(path, std::ios::binary);
+
+    if (!out)
+    {
+        std::cout << "Could not write " << path << std::endl;
+        return false;
+    }
+
+    // Twice the book size keeps the set at most half full, and the probes short
+    KeySet     keys(2 * count + 2 * threads);
+    Counters   counters;
+    std::mutex out_mtx;
+
+    std::vector<std::thread> thread_pool;
+
+    auto start = std::chrono::steady_clock::now();
+
+    counters.running = threads;
+
+    for (int id = 0; id < threads; id++)
+        thread_pool.emplace_back(generate, std::cref(roots), count, min_plies, max_plies, weighted,
+                                 std::ref(keys), std::ref(counters), std::ref(out), std::ref(out_mtx), control);
+
+    auto seconds = [&]() { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); };
+
+    for (uint64_t last = unix_ms(); counters.running; Sleep(100))
+        if (unix_ms() - last >= 5000)
+        {
+            uint64_t written = std::min<uint64_t>(counters.claimed, count);
+
+            printf("%s %llu/%llu openings, %.0f per minute\n", time_().c_str(),
+                   (unsigned long long)written, (unsigned long long)count, written / seconds() * 60);
+
+            last = unix_ms();
+        }
+
+    for (std::thread& thread : thread_pool)
+        thread.join();
+
+    out.flush();
+
+    uint64_t written = std::min<uint64_t>(counters.claimed, count);
+    double   elapsed = seconds();
+
+    printf("%llu openings written to %s in %.1f s, %.0f per minute, from %llu playouts: %llu over, %llu duplicates\n",
+           (unsigned long long)written, path.c_str(), elapsed, written / std::max(elapsed, 1e-6) * 60,
+           (unsigned long long)counters.playouts.load(), (unsigned long long)counters.decided.load(), (unsigned long long)counters.duplicates.load());
+
+    if (written < count && !control->quitting())
+        printf("No new openings were found any more, the ply range may be too small for %llu openings\n", (unsigned long long)count);
+
+    return bool(out);
+}
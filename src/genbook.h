@@ -0,0 +1,35 @@
+
+#ifndef GENBOOK_H
+#define GENBOOK_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "control.h"
+
+// Fixed capacity open addressing set of 64-bit keys that any number of threads insert into
+// without a lock. A slot is claimed with one compare-exchange; 0 marks an empty slot, so a
+// key of 0 is stored as 1
+class KeySet
+{
+public:
+    explicit KeySet(uint64_t capacity);
+
+    bool insert(uint64_t key);  // false if the key was already in, or the set is full
+
+private:
+    std::unique_ptr<std::atomic<uint64_t>[]> slots;
+    uint64_t                                 mask;
+};
+
+// --genbook: writes count openings to path, each the end of a random playout of min_plies to
+// max_plies from the start position or a random position of seeds. Positions that are over
+// (mate, stalemate, repetition, fifty moves, insufficient material) or were already written,
+// by Zobrist key, are skipped. weighted playouts prefer captures and central pawn and minor
+// piece moves over king moves
+bool run_genbook(const std::string& path, uint64_t count, int min_plies, int max_plies, const std::string& seeds, bool weighted,
+                 int threads, Control *control);
+
+#endif
@@ -0,0 +1,132 @@
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <immintrin.h>
+
+// HDR style histogram: values below 32 are exact, above that every power of two is
+// split into 32 linear sub-buckets, which keeps the relative error of any
+// recorded value under 3% over the whole 64 bit range
+class Histogram
+{
+public:
+    Histogram() { clear(); }
+
+    void clear()
+    {
+        counts.fill(0);
+        m_count = m_sum = m_max = 0;
+        m_min = UINT64_MAX;
+    }
+
+    void record(uint64_t v, uint64_t n = 1)
+    {
+        counts[index(v)] += n;
+        m_count += n;
+        m_sum += v * n;
+        m_max = std::max(m_max, v);
+        m_min = std::min(m_min, v);
+    }
+
+    void merge(const Histogram& h)
+    {
+        for (size_t i = 0; i < counts.size(); i++)
+            counts[i] += h.counts[i];
+
+        m_count += h.m_count;
+        m_sum   += h.m_sum;
+        m_max    = std::max(m_max, h.m_max);
+        m_min    = std::min(m_min, h.m_min);
+    }
+
+    uint64_t percentile(double p) const
+    {
+        if (!m_count)
+            return 0;
+
+        uint64_t rank = std::max<uint64_t>(1, uint64_t(p / 100 * m_count + 0.5)), seen = 0;
+
+        for (size_t i = 0; i < counts.size(); i++)
+            if ((seen += counts[i]) >= rank)
+                return std::clamp(value(i), m_min, m_max);
+
+        return m_max;
+    }
+
+    uint64_t count() const { return m_count; }
+    uint64_t max() const { return m_max; }
+    uint64_t min() const { return m_count ? m_min : 0; }
+    double mean() const { return m_count ? double(m_sum) / m_count : 0.0; }
+
+    void print(const char *label, const char *unit) const
+    {
+        printf("%-24s n=%-9llu mean %8.1f  p50 %7llu  p90 %7llu  p99 %7llu  p99.9 %7llu  max %7llu %s\n",
+               label, (unsigned long long)count(), mean(),
+               (unsigned long long)percentile(50), (unsigned long long)percentile(90),
+               (unsigned long long)percentile(99), (unsigned long long)percentile(99.9),
+               (unsigned long long)max(), unit);
+    }
+
+    static constexpr int SubBits = 5;
+    static constexpr int Sub     = 1 << SubBits;
+    static constexpr int Buckets = (64 - SubBits + 1) * Sub;
+
+    // Bucket of a value, and the value a bucket stands for
+    static int index(uint64_t v)
+    {
+        if (v < Sub)
+            return v;
+
+        int exp = 63 - _lzcnt_u64(v);
+        return (exp - SubBits + 1) * Sub + ((v >> (exp - SubBits)) & (Sub - 1));
+    }
+
+    static uint64_t value(int i)
+    {
+        if (i < Sub)
+            return i;
+
+        int exp = i / Sub + SubBits - 1;
+        return (uint64_t(Sub + i % Sub) << (exp - SubBits)) + (uint64_t(1) << (exp - SubBits)) / 2;
+    }
+
+private:
+    std::array<uint64_t, Buckets> counts;
+    uint64_t m_count, m_sum, m_max, m_min;
+};
+
+// Histogram that any number of threads record to and read from without a lock. A snapshot
+// only sees the buckets, so its min, max and mean are those of the buckets within 3%
+class AtomicHistogram
+{
+public:
+    void record(uint64_t v)
+    {
+        counts[Histogram::index(v)].fetch_add(1, std::memory_order_relaxed);
+        m_sum.fetch_add(v, std::memory_order_relaxed);
+    }
+
+    Histogram snapshot() const
+    {
+        Histogram h;
+
+        for (int i = 0; i < Histogram::Buckets; i++)
+            if (uint64_t n = counts[i].load(std::memory_order_relaxed))
+                h.record(Histogram::value(i), n);
+
+        return h;
+    }
+
+    uint64_t sum() const { return m_sum.load(std::memory_order_relaxed); }
+
+private:
+    std::array<std::atomic<uint64_t>, Histogram::Buckets> counts {};
+    std::atomic<uint64_t>                                 m_sum  {};
+};
+
+#endif
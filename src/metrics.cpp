@@ -0,0 +1,295 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define NOMINMAX
+
+#include "metrics.h"
+
+#include <winsock2.h>
+#include <windows.h>
+
+#include <chrono>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+#include "checkpoint.h"
+#include "stats.h"
+
+#pragma comment(lib, "ws2_32.lib")
+
+namespace {
+
+constexpr int RateSeconds  = 10;  // moves per second is averaged over this long
+constexpr int WriteSeconds = 5;   // between rewrites of --metrics_file
+
+// Label values escape backslashes and quotes, which engine paths may well contain
+std::string label(const std::string& value)
+{
+    std::string s;
+
+    for (char c : value)
+    {
+        if (c == '\\' || c == '"')
+            s += '\\';
+        s += c;
+    }
+
+    return s;
+}
+
+}
+
+Metrics& metrics()
+{
+    static Metrics m;
+    return m;
+}
+
+EngineMetrics& Metrics::engine(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+
+    for (EngineMetrics& e : engines)
+        if (e.name == name)
+            return e;
+
+    engines.emplace_back().name = name;
+
+    return engines.back();
+}
+
+void Metrics::set_progress(int finished, int total)
+{
+    m_finished.store(finished, std::memory_order_relaxed);
+    m_total.store(total, std::memory_order_relaxed);
+}
+
+uint64_t Metrics::moves() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+
+    uint64_t n = 0;
+
+    for (const EngineMetrics& e : engines)
+        n += e.moves.load(std::memory_order_relaxed);
+
+    return n;
+}
+
+std::string Metrics::render(const Control& control, double moves_per_second) const
+{
+    std::string out;
+    char        line[512];
+
+    auto metric = [&](const char *name, const char *type, const char *help) {
+        snprintf(line, sizeof(line), "# HELP mm_%s %s\n# TYPE mm_%s %s\n", name, help, name, type);
+        out += line;
+    };
+
+    auto value = [&](const char *name, const std::string& labels, double v) {
+        snprintf(line, sizeof(line), labels.empty() ? "mm_%s%s %.17g\n" : "mm_%s{%s} %.17g\n", name, labels.c_str(), v);
+        out += line;
+    };
+
+    metric("games_finished", "gauge", "Games of the run that are finished, including those of a resumed run");
+    value("games_finished", "", m_finished.load(std::memory_order_relaxed));
+    metric("games_total", "gauge", "Games the run will play");
+    value("games_total", "", m_total.load(std::memory_order_relaxed));
+    metric("threads_active", "gauge", "Threads allowed to start games");
+    value("threads_active", "", control.active());
+    metric("moves_per_second", "gauge", "Moves played per second over the last 10 seconds");
+    value("moves_per_second", "", moves_per_second);
+
+    std::lock_guard<std::mutex> lock(mtx);
+
+    std::vector<std::string> names;
+
+    for (const EngineMetrics& e : engines)
+        names.push_back("engine=\"" + label(e.name) + "\"");
+
+    metric("engine_games", "counter", "Games scored, by result from the engine's side");
+    for (size_t i = 0; i < engines.size(); i++)
+    {
+        value("engine_games", names[i] + ",result=\"win\"",  engines[i].wins.load(std::memory_order_relaxed));
+        value("engine_games", names[i] + ",result=\"draw\"", engines[i].draws.load(std::memory_order_relaxed));
+        value("engine_games", names[i] + ",result=\"loss\"", engines[i].losses.load(std::memory_order_relaxed));
+    }
+
+    metric("engine_elo", "gauge", "Elo of the engine's score against all its opponents");
+    for (size_t i = 0; i < engines.size(); i++)
+        value("engine_elo", names[i], elo_diff(engines[i].wins, engines[i].losses, engines[i].draws));
+
+    metric("engine_elo_margin", "gauge", "95% error margin of engine_elo");
+    for (size_t i = 0; i < engines.size(); i++)
+        value("engine_elo_margin", names[i], elo_margin(engines[i].wins, engines[i].losses, engines[i].draws));
+
+    metric("engine_crashes", "counter", "Games lost because the engine exited");
+    for (size_t i = 0; i < engines.size(); i++)
+        value("engine_crashes", names[i], engines[i].crashes.load(std::memory_order_relaxed));
+
+    metric("engine_time_losses", "counter", "Games lost on time, with the engine terminated by the watchdog");
+    for (size_t i = 0; i < engines.size(); i++)
+        value("engine_time_losses", names[i], engines[i].time_losses.load(std::memory_order_relaxed));
+
+    metric("engine_illegal_moves", "counter", "Illegal or unparsable moves");
+    for (size_t i = 0; i < engines.size(); i++)
+        value("engine_illegal_moves", names[i], engines[i].illegal_moves.load(std::memory_order_relaxed));
+
+    metric("engine_moves", "counter", "Moves played");
+    for (size_t i = 0; i < engines.size(); i++)
+        value("engine_moves", names[i], engines[i].moves.load(std::memory_order_relaxed));
+
+    auto summary = [&](const char *name, const char *help, AtomicHistogram EngineMetrics::*hist) {
+        metric(name, "summary", help);
+
+        for (size_t i = 0; i < engines.size(); i++)
+        {
+            const AtomicHistogram& h = engines[i].*hist;
+            Histogram              s = h.snapshot();
+
+            for (double q : { 50.0, 90.0, 99.0, 99.9 })
+            {
+                snprintf(line, sizeof(line), ",quantile=\"%g\"", q / 100);
+                value(name, names[i] + line, s.percentile(q));
+            }
+
+            value((name + std::string("_sum")).c_str(), names[i], h.sum());
+            value((name + std::string("_count")).c_str(), names[i], s.count());
+        }
+    };
+
+    summary("engine_think_microseconds", "From the 'go' reaching the engine's pipe until its bestmove was read", &EngineMetrics::think);
+    summary("engine_overshoot_microseconds", "Think time beyond --time", &EngineMetrics::overshoot);
+
+    return out;
+}
+
+MetricsExporter::MetricsExporter(const Control& control, int port, const std::string& path)
+    : m_control(control), m_path(path), m_listener(INVALID_SOCKET), m_rate(0), quit(false)
+{
+    if (port)
+    {
+        WSADATA wsa;
+        sockaddr_in addr = {};
+
+        addr.sin_family      = AF_INET;
+        addr.sin_port        = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        SOCKET s = WSAStartup(MAKEWORD(2, 2), &wsa) == 0 ? socket(AF_INET, SOCK_STREAM, IPPROTO_TCP) : INVALID_SOCKET;
+
+        if (s == INVALID_SOCKET || bind(s, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(s, 16) != 0)
+        {
+            printf("Could not listen on 127.0.0.1:%d, metrics are not served\n", port);
+
+            if (s != INVALID_SOCKET)
+                closesocket(s);
+        }
+        else
+        {
+            printf("Serving metrics on http://127.0.0.1:%d/metrics\n", port);
+            m_listener = s;
+        }
+    }
+
+    thread = std::thread(&MetricsExporter::loop, this);
+}
+
+MetricsExporter::~MetricsExporter()
+{
+    quit = true;
+    thread.join();
+
+    if (m_listener != INVALID_SOCKET)
+    {
+        closesocket(m_listener);
+        WSACleanup();
+    }
+
+    if (!m_path.empty())
+        replace_file(m_path, metrics().render(m_control, m_rate));
+}
+
+void MetricsExporter::loop()
+{
+    using Clock = std::chrono::steady_clock;
+
+    std::deque<std::pair<Clock::time_point, uint64_t>> samples;
+    Clock::time_point written = Clock::now();
+
+    while (!quit)
+    {
+        if (m_listener == INVALID_SOCKET)
+            Sleep(100);
+        else
+        {
+            fd_set  readable;
+            timeval timeout = { 0, 100000 };
+
+            FD_ZERO(&readable);
+            FD_SET(m_listener, &readable);
+
+            if (select(m_listener + 1, &readable, NULL, NULL, &timeout) == 1)
+                serve();
+        }
+
+        Clock::time_point now = Clock::now();
+
+        if (samples.empty() || now - samples.back().first >= std::chrono::seconds(1))
+        {
+            samples.emplace_back(now, metrics().moves());
+
+            while (now - samples.front().first > std::chrono::seconds(RateSeconds))
+                samples.pop_front();
+
+            double seconds = std::chrono::duration<double>(now - samples.front().first).count();
+            m_rate = seconds > 0 ? (samples.back().second - samples.front().second) / seconds : 0;
+        }
+
+        if (!m_path.empty() && now - written >= std::chrono::seconds(WriteSeconds))
+        {
+            if (!replace_file(m_path, metrics().render(m_control, m_rate)))
+                printf("Could not write %s\n", m_path.c_str());
+
+            written = now;
+        }
+    }
+}
+
+// One request per connection: GET /metrics or GET / get the metrics, anything else a 404
+void MetricsExporter::serve()
+{
+    SOCKET client = accept(m_listener, NULL, NULL);
+
+    if (client == INVALID_SOCKET)
+        return;
+
+    DWORD timeout = 1000;
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+
+    std::string request;
+    char        buffer[4096];
+
+    for (int n; request.find("\r\n\r\n") == std::string::npos && request.size() < 65536
+                && (n = recv(client, buffer, sizeof(buffer), 0)) > 0;)
+        request.append(buffer, n);
+
+    bool found = request.rfind("GET /metrics ", 0) == 0 || request.rfind("GET / ", 0) == 0;
+
+    std::string body = found ? metrics().render(m_control, m_rate) : "Not found\n";
+    std::string response = std::string(found ? "HTTP/1.1 200 OK\r\n" : "HTTP/1.1 404 Not Found\r\n")
+                         + "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                         + "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                         + "Connection: close\r\n\r\n" + body;
+
+    for (size_t sent = 0; sent < response.size();)
+    {
+        int n = send(client, response.data() + sent, response.size() - sent, 0);
+
+        if (n <= 0)
+            break;
+
+        sent += n;
+    }
+
+    closesocket(client);
+}
@@ -0,0 +1,67 @@
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "control.h"
+#include "histogram.h"
+
+// Live counters of one engine, shared by all its processes on all threads. Game threads only
+// add to them, so the exporter reads them without taking any lock a game thread waits on
+struct EngineMetrics
+{
+    std::string name;
+
+    std::atomic<uint64_t> wins {}, losses {}, draws {};
+    std::atomic<uint64_t> crashes {}, time_losses {}, illegal_moves {};
+    std::atomic<uint64_t> moves {};
+
+    AtomicHistogram think;      // microseconds, as in MoveTimes
+    AtomicHistogram overshoot;
+};
+
+class Metrics
+{
+public:
+    EngineMetrics& engine(const std::string& name);  // added on first use, never removed
+    void set_progress(int finished, int total);
+    uint64_t moves() const;
+
+    std::string render(const Control& control, double moves_per_second) const;  // Prometheus text format
+
+private:
+    mutable std::mutex        mtx;  // guards the list, not the counters
+    std::deque<EngineMetrics> engines;
+    std::atomic<int>          m_finished {};
+    std::atomic<int>          m_total {};
+};
+
+Metrics& metrics();
+
+// --metrics_port serves the metrics to any GET on 127.0.0.1:port, --metrics_file rewrites
+// the file with them every few seconds. Moves per second is taken over the last 10 seconds
+class MetricsExporter
+{
+public:
+    MetricsExporter(const Control& control, int port, const std::string& path);
+   ~MetricsExporter();
+
+private:
+    void loop();
+    void serve();
+
+    const Control&    m_control;
+    std::string       m_path;
+    uintptr_t         m_listener;
+    double            m_rate;
+    std::atomic<bool> quit;
+    std::thread       thread;
+};
+
+#endif
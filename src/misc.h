@@ -0,0 +1,27 @@
+
+#ifndef MISC_H
+#define MISC_H
+
+#include <chrono>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+inline uint64_t unix_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+inline std::string time_()
+{
+    std::time_t current_time = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+
+    std::tm *local_time = std::localtime(&current_time);
+
+    std::ostringstream time_stream;
+    time_stream << std::put_time(local_time, "%H:%M:%S");
+
+    return time_stream.str();
+}
+
+#endif
@@ -1,239 +1,594 @@
-
-#define _CRT_SECURE_NO_WARNINGS
-#define NOMINMAX
-
-#include "mm.h"
-
-#include <chrono>
-#include <ctime>
-#include <fstream>
-#include <iomanip>
-#include <iostream>
-#include <sstream>
-#include <thread>
-#include <vector>
-
-#include "bitboard.h"
-#include "engine.h"
-#include "args.h"
-#include "position.h"
-#include "stats.h"
-
-uint64_t unix_ms() {
-    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-}
-
-Color random_color() {
-    static std::mt19937_64 rng(unix_ms());
-    return rng() & 1;
-}
-
-std::string time_()
-{
-    std::time_t current_time = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-
-    std::tm *local_time = std::localtime(&current_time);
-
-    std::ostringstream time_stream;
-    time_stream << std::put_time(local_time, "%H:%M:%S");
-
-    return time_stream.str();
-}
-
-void handle_stdin(Status *status)
-{
-    std::string in;
-
-    do
-    {
-        std::cin >> in;
-
-        if (in == "stop")
-            *status = STOP;
-        else if (in == "go")
-            *status = GO;
-
-    } while (in != "quit");
-
-    *status = QUIT;
-}
-
-void Match::run(Status *status)
-{
-    uint64_t start_time = unix_ms();
-
-    for (int i = 0; i < fens.size(); i++)
-    {
-        uint64_t elapsed = unix_ms() - start_time;
-        uint64_t time_per_game = elapsed / std::max(1, i);
-        uint64_t eta_seconds = time_per_game * (fens.size() - i) / 1000;
-
-        int hours = eta_seconds / 3600;
-        int minutes = (eta_seconds % 3600) / 60;
-        int seconds = eta_seconds % 60;
-
-        std::ostringstream eta;
-        eta << std::setw(2) << std::setfill('0') << hours   << ":"
-            << std::setw(2) << std::setfill('0') << minutes << ":"
-            << std::setw(2) << std::setfill('0') << seconds;
-
-        printf (
-            "%s Match %d %s %d %s %d Draws %d (%+d +/- %d) Game %d/%llu ETA %s\n",
-            time_().c_str(),
-            m_id,
-            e1.name().c_str(),
-            e1.wins,
-            e2.name().c_str(),
-            e2.wins,
-            draws,
-            (int)elo_diff  (e1.wins, e2.wins, draws),
-            (int)elo_margin(e1.wins, e2.wins, draws),
-            i,
-            fens.size(),
-            eta.str().c_str()
-        );
-
-        pos.set(fens[i]);
-
-        Color e1_color = random_color(), e2_color = !e1_color;
-
-        std::stringstream uci, pgn;
-
-        uci << "position fen " << fens[i] << " ";
-
-        pgn << "[White \"" << (e1_color == WHITE ? e1.name() : e2.name()) << "\"]\n"
-            << "[Black \"" << (e1_color == BLACK ? e1.name() : e2.name()) << "\"]\n"
-            << "[FEN \"" << fens[i] << "\"]\n";
-
-        if (pos.black_to_move()) pgn << "1... ";
-
-        e1.write_to_stdin("ucinewgame\n" + uci.str() + "\n");
-        e2.write_to_stdin("ucinewgame\n" + uci.str() + "\n");
-
-        uci << "moves ";
-        log << uci.str() << std::flush;
-
-        for (int pgn_num = 1; *status != QUIT;)
-        {
-            for (;*status == STOP; Sleep(100));
-
-            Engine& engine = pos.side_to_move() == e1_color ? e1 : e2;
-
-            std::string uci_move = engine.best_move();
-            Move move = uci_to_move(uci_move, pos);
-
-            if (move == Move::null())
-            {
-                log << std::endl << pgn.str() 
-                    << std::endl << pos.to_string()
-                    << std::endl << engine.name() << ": " << uci_move << " <- Invalid";
-
-                failed = true;
-                break;
-            }
-
-            if (pos.white_to_move())
-                pgn << pgn_num << ". ";
-            pgn << move_to_san(move, pos) << " ";
-            if (pos.black_to_move())
-                pgn_num++;
-
-            uci << uci_move << " ";
-            log << uci_move << " " << std::flush;
-
-            e1.write_to_stdin(uci.str() + "\n");
-            e2.write_to_stdin(uci.str() + "\n");
-
-            pos.do_move(move);
-
-            if (GameState g = pos.game_state(); g != ONGOING)
-            {
-                if (g == MATE) {
-                    engine.wins++;
-                    pgn << (pos.white_to_move() ? "0-1" : "1-0");
-                } else {
-                    draws++;
-                    pgn << "1/2-1/2";
-                }
-
-                log << std::endl << pgn.str() 
-                    << std::endl << (g == MATE       ? "Checkmate"
-                                   : g == STALEMATE  ? "Stalemate"
-                                   : g == REPETITION ? "Repetition"
-                                   : g == FIFTY_MOVE ? "Fifty-move rule" : "?") << " "
-                    << e1.name() << ": " << e1.wins << " " << e2.name() << ": " << e2.wins << " Draws: " << draws << "\n" << std::endl;
-
-                break;
-            }
-        }
-
-        if (*status == QUIT || failed) break;
-    }
-
-    e1.kill();
-    e2.kill();
-
-    std::cout << "Match " << m_id << (failed ? ": Engine error" : ": Done") << std::endl;
-}
-
-int main(int argc, char *argv[])
-{
-    Bitboards::init();
-    Position::init();
-
-    verify_args(argc, argv);
-    
-    std::string engine1_path = get_required("engine1", argc, argv);
-    std::string engine2_path = get_required("engine2", argc, argv);
-    int time = std::stoi(get_with_default("time", argc, argv, "100"));
-    int threads = std::stoi(get_with_default("threads", argc, argv, "1"));
-    std::string fen_file = get_with_default("fen_file", argc, argv, "lc01k.txt");
-
-    std::vector<Match*> matches;
-    std::vector<std::thread> thread_pool;
-
-    Status status = GO;
-    std::thread t(handle_stdin, &status);
-    t.detach();
-
-    for (int id = 0; id < threads; id++) {
-        matches.push_back(new Match(engine1_path, engine2_path, time, id, fen_file));
-        thread_pool.emplace_back(&Match::run, matches.back(), &status);
-    }
-
-    for (std::thread& thread : thread_pool)
-        thread.join();
-
-    int e1_wins = 0, e2_wins = 0, draws = 0;
-
-    for (Match *m : matches) {
-        e1_wins += m->e1.wins;
-        e2_wins += m->e2.wins;
-        draws += m->draws;
-        delete m;
-    }
-
-    int total = e1_wins + e2_wins + draws, decisive = total - draws;
-    
-    double e1_winrate = decisive > 0 ? (double)e1_wins / decisive : 0.0;
-    double e2_winrate = decisive > 0 ? (double)e2_wins / decisive : 0.0;
-    double diff = elo_diff(e1_wins, e2_wins, draws);
-    double margin = elo_margin(e1_wins, e2_wins, draws);
-
-    printf(R"(
-+-----------------+-------+----------+
-|     Outcome     |   #   | Win Rate |
-+-----------------+-------+----------+
-| %-16s|%6d |%8.2f%% |
-| %-16s|%6d |%8.2f%% |
-| Draws           |%6d |          |
-| Total           |%6d |%6d ms |
-+-----------------+-------+----------+
-%s is %f (+/- %f) elo ahead of %s
-)",
-    engine1_path.c_str(), e1_wins, e1_winrate * 100,
-    engine2_path.c_str(), e2_wins, e2_winrate * 100,
-    draws,
-    total, time,
-    engine1_path.c_str(), diff, margin, engine2_path.c_str());
-}
+
+#define _CRT_SECURE_NO_WARNINGS
+#define NOMINMAX
+
+#include "mm.h"
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "bitboard.h"
+#include "checkpoint.h"
+#include "control.h"
+#include "coordinator.h"
+#include "engine.h"
+#include "epd.h"
+#include "genbook.h"
+#include "args.h"
+#include "autotune.h"
+#include "bench.h"
+#include "metrics.h"
+#include "misc.h"
+#include "position.h"
+#include "recording.h"
+#include "results.h"
+#include "spsa.h"
+#include "stats.h"
+#include "tournament.h"
+#include "verify.h"
+
+MatchQueue::MatchQueue(const std::vector<std::string>& fens, const std::vector<MatchState>& states, OpeningHistory& history)
+    : m_fens(fens), m_history(history), passes(states)
+{
+    std::vector<double> plies(fens.size());
+
+    for (size_t i = 0; i < fens.size(); i++)
+        plies[i] = history.expected_plies(fens[i]);
+
+    for (int p = 0; p < passes.size(); p++)
+    {
+        order.emplace_back(fens.size());
+        colors.emplace_back();
+        std::iota(order[p].begin(), order[p].end(), 0);
+
+        std::mt19937 g(passes[p].seed);
+        std::shuffle(order[p].begin(), order[p].end(), g);
+
+        for (int i = 0; i < fens.size(); i++)
+            colors[p].push_back(g() & 1);
+
+        for (int i = 0; i < fens.size(); i++)
+            if (passes[p].done[i])
+                finished++;
+            else
+                queue.push_back({ p, i });
+    }
+
+    total = passes.size() * fens.size();
+
+    // Handed out from the back: longest expected game first, then in shuffled order across the passes
+
+    std::stable_sort(queue.begin(), queue.end(), [&](const QueuedGame& a, const QueuedGame& b) {
+        double pa = plies[order[a.pass][a.index]], pb = plies[order[b.pass][b.index]];
+        return pa != pb ? pa < pb : a.index != b.index ? a.index > b.index : a.pass > b.pass;
+    });
+}
+
+bool MatchQueue::next(QueuedGame& game)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+
+    if (queue.empty())
+        return false;
+
+    game = queue.back();
+    game.e1_color = colors[game.pass][game.index];
+    queue.pop_back();
+
+    return true;
+}
+
+void MatchQueue::release(const QueuedGame& game)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    queue.push_back(game);
+}
+
+int MatchQueue::report(const QueuedGame& game, int e1_result, const OpeningOutcome& outcome)
+{
+    if (outcome.plies)
+        m_history.record(fen(game), outcome);
+
+    std::lock_guard<std::mutex> lock(mtx);
+
+    MatchState& s = passes[game.pass];
+
+    if (e1_result > 0)
+        s.e1_wins++;
+    else if (e1_result < 0)
+        s.e2_wins++;
+    else
+        s.draws++;
+
+    s.done[game.index] = true;
+
+    return ++finished;
+}
+
+std::vector<MatchState> MatchQueue::state()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return passes;
+}
+
+MatchState MatchQueue::totals()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+
+    MatchState t = { 0, 0, 0, 0 };
+
+    for (const MatchState& s : passes)
+    {
+        t.e1_wins += s.e1_wins;
+        t.e2_wins += s.e2_wins;
+        t.draws   += s.draws;
+    }
+
+    return t;
+}
+
+void Match::run(Control *control, GameQueue& queue)
+{
+    uint64_t   start_time = unix_ms();
+    int        start      = queue.finished;
+    QueuedGame game;
+    bool       unrecorded = false;
+
+    while (control->next_game(m_id) && queue.next(game))
+    {
+        MatchState t = queue.totals();
+        int played = queue.finished;
+
+        uint64_t elapsed = unix_ms() - start_time;
+        uint64_t time_per_game = elapsed / std::max(1, played - start);
+        uint64_t eta_seconds = time_per_game * (queue.total - played) / 1000;
+
+        int hours = eta_seconds / 3600;
+        int minutes = (eta_seconds % 3600) / 60;
+        int seconds = eta_seconds % 60;
+
+        std::ostringstream eta;
+        eta << std::setw(2) << std::setfill('0') << hours   << ":"
+            << std::setw(2) << std::setfill('0') << minutes << ":"
+            << std::setw(2) << std::setfill('0') << seconds;
+
+        printf (
+            "%s Match %d %s %d %s %d Draws %d (%+d +/- %d) Game %d/%d ETA %s Overshoot p99 %.1f/%.1f ms\n",
+            time_().c_str(),
+            m_id,
+            e1.name().c_str(),
+            t.e1_wins,
+            e2.name().c_str(),
+            t.e2_wins,
+            t.draws,
+            (int)elo_diff  (t.e1_wins, t.e2_wins, t.draws),
+            (int)elo_margin(t.e1_wins, t.e2_wins, t.draws),
+            played,
+            queue.total,
+            eta.str().c_str(),
+            e1.times.overshoot.percentile(99) / 1000.0,
+            e2.times.overshoot.percentile(99) / 1000.0
+        );
+
+        Color       e1_color = game.e1_color;
+        std::string id       = std::to_string(game.pass) + " " + std::to_string(game.index);
+
+        e1.set_game(id);
+        e2.set_game(id);
+
+        Engine& white = e1_color == WHITE ? e1 : e2;
+        Engine& black = e1_color == WHITE ? e2 : e1;
+
+        GameResult r = play_game(white, black, queue.fen(game), control, log, data.get());
+
+        if (r.error == ENGINE_ILLEGAL_MOVE || r.aborted())
+        {
+            if (r.failed)
+                (r.winner == WHITE ? black : white).metrics().illegal_moves++;
+
+            failed     = r.failed;
+            unrecorded = r.error == ENGINE_NOT_RECORDED;
+            queue.release(game);
+            break;
+        }
+
+        // A time forfeit or crash is a loss; the loser gets a fresh process for the next game
+        if (r.failed)
+            (r.winner == e1_color ? e2 : e1).restart();
+
+        record_metrics(white, black, r);
+        metrics().set_progress(queue.report(game, !r.decisive() ? 0 : r.winner == e1_color ? 1 : -1, opening_outcome(r)), queue.total);
+
+        t = queue.totals();
+
+        log << " " << e1.name() << ": " << t.e1_wins << " " << e2.name() << ": " << t.e2_wins << " Draws: " << t.draws << "\n" << std::endl;
+    }
+
+    if (data)
+        data->flush();
+
+    e1.kill();
+    e2.kill();
+
+    std::cout << "Match " << m_id << (failed ? ": Engine error" : unrecorded ? ": Replay error, a position was not recorded" : ": Done") << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    verify_args(argc, argv);
+    
+    int time = std::stoi(get_with_default("time", argc, argv, "100"));
+    std::string verify = get_with_default("verify", argc, argv, "");
+    std::string genbook = get_with_default("genbook", argc, argv, "");
+    std::string epd = get_with_default("epd", argc, argv, "");
+    std::string threads_flag = get_with_default("threads", argc, argv, verify.empty() && genbook.empty() && epd.empty() ? "1" : "auto");
+    int threads = threads_flag == "auto" ? std::max(1u, std::thread::hardware_concurrency()) : std::stoi(threads_flag);
+    std::string fen_file = get_with_default("fen_file", argc, argv, "lc01k.txt");
+    std::string datagen = get_with_default("datagen", argc, argv, "");
+    uint64_t rotate = std::stoull(get_with_default("datagen_rotate", argc, argv, "10000000"));
+    std::string results = get_with_default("results", argc, argv, "");
+
+    Engine::limits.grace_ms    = std::stoi(get_with_default("grace", argc, argv, "1000"));
+    Engine::limits.memory_mb   = std::stoull(get_with_default("engine_memory", argc, argv, "0"));
+    Engine::limits.cpu_seconds = std::stoull(get_with_default("engine_cpu", argc, argv, "0"));
+    Engine::low_latency        = has_flag("low_latency", argc, argv);
+
+    Engine::record_dir = get_with_default("record", argc, argv, "");
+
+    if (!Engine::record_dir.empty())
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(Engine::record_dir, ec);
+    }
+
+    Replay replay;
+
+    if (std::string paths = get_with_default("replay", argc, argv, ""); !paths.empty())
+    {
+        std::vector<std::string> files;
+        std::istringstream is(paths);
+        for (std::string path; std::getline(is, path, ',');)
+            files.push_back(path);
+
+        if (!replay.load(files))
+        {
+            std::cout << "Nothing to replay in " << paths << std::endl;
+            return 1;
+        }
+
+        replay.speed   = std::stod(get_with_default("replay_speed", argc, argv, "0"));
+        Engine::replay = &replay;
+    }
+
+    auto replay_summary = [&]() {
+        if (Engine::replay)
+            printf("Replayed %llu answers, %llu replay errors (positions not recorded for the engine asked, %llu of them recorded for another engine)\n",
+                   (unsigned long long)replay.answered.load(), (unsigned long long)replay.missed.load(), (unsigned long long)replay.other_engine.load());
+    };
+
+    std::string history_file = get_with_default("opening_history", argc, argv, "logs\\openings.txt");
+    OpeningHistory history;
+    history.load(history_file);
+
+    std::string openings_report = get_with_default("openings_report", argc, argv, "");
+    std::string openings_prune  = get_with_default("openings_prune", argc, argv, "");
+
+    if (!openings_report.empty() || !openings_prune.empty())
+    {
+        std::vector<std::string> fens = load_openings(fen_file, std::thread::hardware_concurrency());
+
+        if (fens.empty())
+        {
+            std::cout << "No positions found in " << fen_file << std::endl;
+            return 1;
+        }
+
+        report_openings(history, fens, openings_report, openings_prune, std::stoull(get_with_default("openings_min_games", argc, argv, "4")));
+        return 0;
+    }
+
+    Control control(threads);
+    std::thread t(handle_stdin, &control);
+    t.detach();
+
+    std::unique_ptr<Autotuner> autotuner;
+
+    if (threads_flag == "auto" && verify.empty() && genbook.empty() && epd.empty())
+        autotuner = std::make_unique<Autotuner>(control, threads, 1000 * std::stoi(get_with_default("max_overshoot", argc, argv, std::to_string(std::max(2, time / 20)))));
+
+    if (!verify.empty())
+    {
+        std::vector<std::string> paths;
+        std::istringstream is(verify);
+        for (std::string path; std::getline(is, path, ',');)
+            paths.push_back(path);
+
+        return run_verify(paths, threads, &control) ? 1 : 0;
+    }
+
+    if (!genbook.empty())
+    {
+        std::string plies = get_with_default("genbook_plies", argc, argv, "8-16");
+        int min_plies = std::stoi(plies), max_plies = plies.find('-') == std::string::npos ? min_plies : std::stoi(plies.substr(plies.find('-') + 1));
+
+        return run_genbook(genbook, std::stoull(get_with_default("genbook_count", argc, argv, "100000")), min_plies, std::max(min_plies, max_plies),
+                           get_with_default("genbook_seeds", argc, argv, ""), has_flag("genbook_weighted", argc, argv), threads, &control) ? 0 : 1;
+    }
+
+    if (!epd.empty())
+    {
+        std::vector<std::string> paths;
+        std::istringstream is(get_with_default("engines", argc, argv, ""));
+        for (std::string path; std::getline(is, path, ',');)
+            paths.push_back(path);
+
+        if (paths.empty())
+        {
+            paths.push_back(get_required("engine1", argc, argv));
+
+            if (std::string engine2 = get_with_default("engine2", argc, argv, ""); !engine2.empty())
+                paths.push_back(engine2);
+        }
+
+        return run_epd(epd, paths, time, std::stoull(get_with_default("epd_nodes", argc, argv, "0")), threads, results, &control) ? 0 : 1;
+    }
+
+    std::unique_ptr<MetricsExporter> exporter;
+
+    int metrics_port = std::stoi(get_with_default("metrics_port", argc, argv, "0"));
+    std::string metrics_file = get_with_default("metrics_file", argc, argv, "");
+
+    if (metrics_port || !metrics_file.empty())
+        exporter = std::make_unique<MetricsExporter>(control, metrics_port, metrics_file);
+
+    if (has_flag("bench", argc, argv))
+    {
+        run_bench(get_with_default("engine1", argc, argv, "mockengine.exe"),
+                  get_with_default("engine2", argc, argv, "mockengine.exe"),
+                  std::stoi(get_with_default("games", argc, argv, "1000")), threads, fen_file, &control);
+
+        return 0;
+    }
+
+    if (std::string engines = get_with_default("engines", argc, argv, ""); !engines.empty())
+    {
+        std::vector<std::string> paths;
+        std::istringstream is(engines);
+        for (std::string path; std::getline(is, path, ',');)
+            paths.push_back(path);
+
+        std::string type = get_with_default("tournament", argc, argv, "roundrobin");
+        int games = std::stoi(get_with_default("games", argc, argv, "0"));
+        int cache_size = std::stoi(get_with_default("engine_cache", argc, argv, "4"));
+        int rating_interval = std::stoi(get_with_default("rating_interval", argc, argv, "1000"));
+
+        run_tournament(paths, type == "gauntlet" ? GAUNTLET : type == "swiss" ? SWISS : ROUND_ROBIN,
+                       games, time, threads, cache_size, rating_interval, fen_file, &control, &history, results, datagen, rotate);
+
+        replay_summary();
+
+        if (!history.save(history_file))
+            std::cout << "Could not write " << history_file << std::endl;
+
+        return 0;
+    }
+
+    int checkpoint_interval = std::stoi(get_with_default("checkpoint_interval", argc, argv, "60"));
+
+    if (std::string spsa = get_with_default("spsa", argc, argv, ""); !spsa.empty())
+    {
+        std::string engine = get_required("engine1", argc, argv);
+
+        return run_spsa(spsa, engine, std::stoi(get_with_default("games", argc, argv, "2000")), time, threads, fen_file,
+                        get_with_default("checkpoint", argc, argv, "logs\\"+engine_name(engine)+"_spsa_"+std::to_string(time)+".ckpt"),
+                        checkpoint_interval, has_flag("resume", argc, argv), &control) ? 0 : 1;
+    }
+
+    std::string engine1_path = get_required("engine1", argc, argv);
+    std::string engine2_path = get_required("engine2", argc, argv);
+
+    if (std::string worker = get_with_default("worker", argc, argv, ""); !worker.empty())
+        return run_worker(worker, engine1_path, engine2_path, threads, &control, datagen, rotate);
+
+    // Not tied to --threads=auto, or the number of games would depend on the machine's core count
+    int passes = std::stoi(get_with_default("passes", argc, argv, threads_flag == "auto" ? "1" : std::to_string(threads)));
+
+    // The coordinator plays no games itself, --threads only sets the default number of passes
+    int coordinator_port = std::stoi(get_with_default("coordinator", argc, argv, "0"));
+
+    std::string checkpoint = get_with_default("checkpoint", argc, argv, "logs\\"+engine_name(engine1_path)+"_"+engine_name(engine2_path)+"_"+std::to_string(time)+".ckpt");
+
+    CheckpointHeader header = { engine1_path, engine2_path, fen_file, 0, time };
+    std::vector<MatchState> states;
+    std::vector<std::string> fens = load_openings(fen_file, std::thread::hardware_concurrency());
+
+    if (fens.empty())
+    {
+        std::cout << "No positions found in " << fen_file << std::endl;
+        return 1;
+    }
+
+    header.fens = fens.size();
+
+    if (has_flag("resume", argc, argv))
+    {
+        CheckpointHeader saved;
+
+        if (!load_checkpoint(checkpoint, saved, states))
+        {
+            std::cout << "Could not read checkpoint " << checkpoint << std::endl;
+            return 1;
+        }
+
+        if (saved.engine1 != header.engine1 || saved.engine2 != header.engine2 || saved.fen_file != header.fen_file || saved.fens != header.fens || saved.time != header.time)
+        {
+            std::cout << "Checkpoint " << checkpoint << " was written by a different run" << std::endl;
+            return 1;
+        }
+
+        std::cout << "Resuming " << states.size() << " passes over the openings from " << checkpoint << std::endl;
+    }
+    else if (Engine::replay && !replay.seeds.empty())
+    {
+        for (uint64_t seed : replay.seeds)
+            states.push_back({ seed, 0, 0, 0, std::vector<bool>(fens.size()) });
+
+        std::cout << "Replaying the " << states.size() << " recorded passes over the openings" << std::endl;
+    }
+    else
+    {
+        std::random_device rd;
+
+        for (int pass = 0; pass < passes; pass++)
+            states.push_back({ (uint64_t(rd()) << 32) | rd(), 0, 0, 0, std::vector<bool>(fens.size()) });
+    }
+
+    // The seeds give every game its opening and colors, which a replay needs to meet the recorded positions
+    if (!Engine::record_dir.empty() && !Engine::replay)
+    {
+        std::vector<uint64_t> seeds;
+
+        for (const MatchState& s : states)
+            seeds.push_back(s.seed);
+
+        if (!save_seeds(Engine::record_dir + "\\seeds.txt", seeds))
+            std::cout << "Could not write " << Engine::record_dir << "\\seeds.txt" << std::endl;
+    }
+
+    MatchQueue queue(fens, states, history);
+
+    // A resumed run continues the score it had
+    MatchState resumed = queue.totals();
+    EngineMetrics& m1 = metrics().engine(engine_name(engine1_path));
+    EngineMetrics& m2 = metrics().engine(engine_name(engine2_path));
+
+    m1.wins   += resumed.e1_wins;
+    m1.losses += resumed.e2_wins;
+    m2.wins   += resumed.e2_wins;
+    m2.losses += resumed.e1_wins;
+    m1.draws  += resumed.draws;
+    m2.draws  += resumed.draws;
+
+    metrics().set_progress(queue.finished, queue.total);
+
+    std::vector<Match*> matches(threads, nullptr);
+    std::vector<std::thread> thread_pool;
+
+    // A slot starts its engines once it is first let play, so the slots --threads=auto
+    // never activates cost no processes
+    for (int id = 0; id < threads && !coordinator_port; id++)
+        thread_pool.emplace_back([&, id]() {
+            if (!control.next_game(id))
+                return;
+
+            matches[id] = new Match(engine1_path, engine2_path, time, id, datagen, rotate);
+            matches[id]->run(&control, queue);
+        });
+
+    control.set_stats([&]() {
+        MatchState t = queue.totals();
+
+        printf("%s %d %s %d Draws %d (%+d +/- %d) Game %d/%d\n", engine_name(engine1_path).c_str(), t.e1_wins, engine_name(engine2_path).c_str(), t.e2_wins, t.draws,
+               (int)elo_diff(t.e1_wins, t.e2_wins, t.draws), (int)elo_margin(t.e1_wins, t.e2_wins, t.draws), queue.finished.load(), queue.total);
+    });
+
+    auto save = [&]() {
+        states = queue.state();
+
+        if (!save_checkpoint(checkpoint, header, states))
+            std::cout << "Could not write checkpoint " << checkpoint << std::endl;
+    };
+
+    std::atomic<bool> done = false;
+
+    std::thread saver([&]() {
+        for (uint64_t last = unix_ms(); !done; Sleep(100))
+            if (unix_ms() - last >= checkpoint_interval * 1000ull) {
+                save();
+                last = unix_ms();
+            }
+    });
+
+    if (coordinator_port)
+        run_coordinator(queue, coordinator_port, engine_name(engine1_path), engine_name(engine2_path), time, &control);
+
+    for (std::thread& thread : thread_pool)
+        thread.join();
+
+    control.set_stats(nullptr);
+
+    done = true;
+    saver.join();
+    save();
+
+    if (!history.save(history_file))
+        std::cout << "Could not write " << history_file << std::endl;
+
+    MatchState totals = queue.totals();
+
+    int e1_wins = totals.e1_wins, e2_wins = totals.e2_wins, draws = totals.draws;
+    uint64_t positions = 0;
+    EngineSummary e1 = { engine_name(engine1_path) }, e2 = { engine_name(engine2_path) };
+
+    for (Match *m : matches) {
+        if (!m)
+            continue;
+
+        e1.times.merge(m->e1.times);
+        e2.times.merge(m->e2.times);
+        e1.search.merge(m->e1.search);
+        e2.search.merge(m->e2.search);
+        e1.usage.merge(m->e1.usage());
+        e2.usage.merge(m->e2.usage());
+        positions += m->data ? m->data->written() : 0;
+        delete m;
+    }
+
+    int total = e1_wins + e2_wins + draws, decisive = total - draws;
+    
+    double e1_winrate = decisive > 0 ? (double)e1_wins / decisive : 0.0;
+    double e2_winrate = decisive > 0 ? (double)e2_wins / decisive : 0.0;
+    double diff = elo_diff(e1_wins, e2_wins, draws);
+    double margin = elo_margin(e1_wins, e2_wins, draws);
+
+    printf(R"(
++-----------------+-------+----------+
+|     Outcome     |   #   | Win Rate |
++-----------------+-------+----------+
+| %-16s|%6d |%8.2f%% |
+| %-16s|%6d |%8.2f%% |
+| Draws           |%6d |          |
+| Total           |%6d |%6d ms |
++-----------------+-------+----------+
+%s is %f (+/- %f) elo ahead of %s
+)",
+    engine1_path.c_str(), e1_wins, e1_winrate * 100,
+    engine2_path.c_str(), e2_wins, e2_winrate * 100,
+    draws,
+    total, time,
+    engine1_path.c_str(), diff, margin, engine2_path.c_str());
+
+    e1.wins = e2.losses = e1_wins;
+    e2.wins = e1.losses = e2_wins;
+    e1.draws = e2.draws = draws;
+
+    // Move times and resource use of a distributed run are in the summaries of the workers
+    if (!coordinator_port)
+        print_summary({ e1, e2 });
+
+    if (!results.empty() && !write_results(results, { e1, e2 }))
+        std::cout << "Could not write " << results << std::endl;
+
+    if (!datagen.empty())
+        printf("%llu positions written to %s\n", positions, datagen.c_str());
+
+    replay_summary();
+}
@@ -1,51 +1,102 @@
-
-#ifndef MM_H
-#define MM_H
-
-#include <algorithm>
-#include <fstream>
-#include <random>
-#include <sstream>
-
-#include "engine.h"
-#include "position.h"
-#include "uci.h"
-
-enum Status { STOP, GO, QUIT };
-
-class Match
-{
-public:
-    Match(std::string path_1, std::string path_2, int time, int id, std::string fenpath)
-        : e1(path_1, time, id), e2(path_2, time, id), m_id(id), failed(false), draws(0)
-    {
-        e1.write_to_stdin("noverbose\nuci\nisready\n");
-        e2.write_to_stdin("noverbose\nuci\nisready\n");
-
-        log.open("logs\\"+e1.name()+"_"+e2.name()+"_"+std::to_string(time)+"_id"+std::to_string(m_id)+".txt");
-        
-        std::string fen;
-        for (std::ifstream fenfile(fenpath); std::getline(fenfile, fen); fens.push_back(fen));
-
-        std::random_device rd;
-        std::mt19937 g(rd());
-        std::shuffle(fens.begin(), fens.end(), g);
-    }
-
-    ~Match() { log.close(); }
-
-    void run(Status *status);
-
-    Engine e1;
-    Engine e2;
-    int    draws;
-
-private:
-    Position                 pos;
-    int                      m_id;
-    bool                     failed;
-    std::ofstream            log;
-    std::vector<std::string> fens;
-};
-
-#endif
\ No newline at end of file
+#ifndef MM_H
+#define MM_H
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+
+#include "checkpoint.h"
+#include "datagen.h"
+#include "engine.h"
+#include "game.h"
+#include "openings.h"
+
+struct QueuedGame
+{
+    int   pass;
+    int   index;
+    Color e1_color = WHITE;  // drawn from the pass seed, so a replay of the pass gets the same colors
+};
+
+// Where the threads of a match take their games from and report them to: the MatchQueue
+// of this process, or a RemoteQueue leasing them from a coordinator. report() takes how the
+// game ended for the opening history
+class GameQueue
+{
+public:
+    virtual ~GameQueue() = default;
+
+    virtual bool next(QueuedGame& game) = 0;
+    virtual void release(const QueuedGame& game) = 0;
+    virtual int  report(const QueuedGame& game, int e1_result, const OpeningOutcome& outcome) = 0;
+
+    virtual const std::string& fen(const QueuedGame& game) = 0;
+    virtual MatchState totals() = 0;
+
+    std::atomic<int> finished = 0;
+    int              total    = 0;
+};
+
+// The games of all passes over the openings that are left to play, shared by every thread
+// so none runs out of work while others still have some. Openings that led to the longest
+// games in earlier runs are handed out first, so the run does not end waiting on a few long games
+class MatchQueue : public GameQueue
+{
+public:
+    MatchQueue(const std::vector<std::string>& fens, const std::vector<MatchState>& passes, OpeningHistory& history);
+
+    bool next(QueuedGame& game) override;
+    void release(const QueuedGame& game) override;
+    int  report(const QueuedGame& game, int e1_result, const OpeningOutcome& outcome) override;
+
+    const std::string& fen(const QueuedGame& game) override { return m_fens[order[game.pass][game.index]]; }
+
+    std::vector<MatchState> state();
+    MatchState totals() override;
+
+private:
+    std::mutex                     mtx;
+    const std::vector<std::string>& m_fens;
+    OpeningHistory&                m_history;
+    std::vector<std::vector<int>>  order;
+    std::vector<std::vector<Color>> colors;
+    std::vector<MatchState>        passes;
+    std::vector<QueuedGame>        queue;
+};
+
+// One thread with its own pair of engines, playing games from the queue
+class Match
+{
+public:
+    Match(std::string path_1, std::string path_2, int time, int id, std::string datagen = "", uint64_t rotate = 0, std::string tag = "")
+        : e1(path_1, time, id), e2(path_2, time, id), m_id(id), failed(false)
+    {
+        e1.handshake();
+        e2.handshake();
+
+        log.open("logs\\"+e1.name()+"_"+e2.name()+"_"+std::to_string(time)+tag+"_id"+std::to_string(m_id)+".txt");
+
+        if (!datagen.empty())
+            data = std::make_unique<DataWriter>(datagen+"\\"+e1.name()+"_"+e2.name()+tag+"_id"+std::to_string(m_id), rotate);
+    }
+
+    ~Match() { log.close(); }
+
+    void run(Control *control, GameQueue& queue);
+
+    Engine e1;
+    Engine e2;
+
+    std::unique_ptr<DataWriter> data;
+
+private:
+    int           m_id;
+    bool          failed;
+    std::ofstream log;
+};
+
+#endif
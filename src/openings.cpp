@@ -0,0 +1,274 @@
+
+#include "openings.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string_view>
+#include <thread>
+
+#include "position.h"
+
+std::vector<std::string> load_openings(const std::string& path, int threads)
+{
+    // One read and one buffer for the whole file; lines are only copied once they passed
+    std::ifstream in(path, std::ios::binary);
+    std::string   text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    std::vector<std::string_view> lines;
+
+    for (size_t pos = 0, end; pos < text.size(); pos = end + 1)
+    {
+        end = std::min(text.find('\n', pos), text.size());
+
+        std::string_view line(text.data() + pos, end - pos);
+
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+
+        lines.push_back(line);
+    }
+
+    std::vector<const char*> errors(lines.size());
+    std::vector<std::thread> thread_pool;
+
+    threads = std::max<int>(1, std::min<size_t>(threads, lines.size() / 10000 + 1));
+
+    for (int id = 0; id < threads; id++)
+        thread_pool.emplace_back([&, id]() {
+            Position pos;
+
+            for (size_t i = lines.size() * id / threads; i < lines.size() * (id + 1) / threads; i++)
+                if (!lines[i].empty())
+                    errors[i] = pos.set(lines[i]) ? pos.validate() : "not a FEN";
+        });
+
+    for (std::thread& thread : thread_pool)
+        thread.join();
+
+    std::vector<std::string> fens;
+    size_t rejected = 0;
+
+    for (size_t i = 0; i < lines.size(); i++)
+    {
+        if (lines[i].empty())
+            continue;
+
+        if (!errors[i])
+        {
+            fens.emplace_back(lines[i]);
+            continue;
+        }
+
+        if (++rejected <= 100)
+            std::cout << path << ":" << i + 1 << ": " << errors[i] << ": " << lines[i] << "\n";
+    }
+
+    if (rejected)
+        std::cout << rejected << " of " << rejected + fens.size() << " positions in " << path << " rejected" << std::endl;
+
+    return fens;
+}
+
+bool OpeningHistory::load(const std::string& path)
+{
+    std::ifstream in(path);
+
+    if (!in)
+        return false;
+
+    std::lock_guard<std::mutex> lock(mtx);
+
+    std::string line;
+
+    if (!std::getline(in, line) || line != "openings 2")
+        return false;
+
+    while (std::getline(in, line))
+    {
+        std::istringstream is(line);
+        std::string fen;
+        Entry e = {};
+
+        is >> e.games >> e.plies >> e.white_wins >> e.black_wins >> e.draws;
+
+        for (int g = MATE; g <= FIFTY_MOVE; g++)
+            is >> e.ended[g];
+
+        is >> e.exit_eval;
+
+        if (!is || !std::getline(is >> std::ws, fen) || !e.games)
+            continue;
+
+        Entry& entry = entries[fen];
+        entry.games      += e.games;
+        entry.plies      += e.plies;
+        entry.white_wins += e.white_wins;
+        entry.black_wins += e.black_wins;
+        entry.draws      += e.draws;
+        entry.exit_eval  += e.exit_eval;
+
+        for (int g = MATE; g <= FIFTY_MOVE; g++)
+            entry.ended[g] += e.ended[g];
+
+        games += e.games;
+        plies += e.plies;
+    }
+
+    return true;
+}
+
+bool OpeningHistory::save(const std::string& path) const
+{
+    std::ofstream out(path);
+    std::lock_guard<std::mutex> lock(mtx);
+
+    out << "openings 2\n";
+
+    for (const auto& [fen, e] : entries)
+    {
+        out << e.games << " " << e.plies << " " << e.white_wins << " " << e.black_wins << " " << e.draws;
+
+        for (int g = MATE; g <= FIFTY_MOVE; g++)
+            out << " " << e.ended[g];
+
+        out << " " << e.exit_eval << " " << fen << "\n";
+    }
+
+    return bool(out.flush());
+}
+
+void OpeningHistory::record(const std::string& fen, const OpeningOutcome& outcome)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+
+    Entry& entry = entries[fen];
+    entry.games++;
+    entry.plies += outcome.plies;
+    entry.ended[outcome.state]++;
+    entry.exit_eval += outcome.exit_eval;
+
+    (outcome.white_score > 0 ? entry.white_wins : outcome.white_score < 0 ? entry.black_wins : entry.draws)++;
+
+    games++;
+    plies += outcome.plies;
+}
+
+double OpeningHistory::expected_plies(const std::string& fen) const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+
+    auto it = entries.find(fen);
+
+    return it != entries.end() ? double(it->second.plies) / it->second.games
+         : games               ? double(plies) / games : 0;
+}
+
+std::vector<OpeningStats> OpeningHistory::stats(const std::vector<std::string>& fens, uint64_t min_games) const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+
+    std::vector<OpeningStats> stats;
+
+    for (const std::string& fen : fens)
+    {
+        OpeningStats s = {};
+        s.fen = fen;
+
+        auto it = entries.find(fen);
+
+        if (it != entries.end())
+        {
+            const Entry& e = it->second;
+
+            s.games      = e.games;
+            s.white_wins = e.white_wins;
+            s.black_wins = e.black_wins;
+            s.draws      = e.draws;
+            s.plies      = double(e.plies) / e.games;
+
+            std::copy(std::begin(e.ended), std::end(e.ended), s.ended);
+        }
+
+        if (s.scored())
+        {
+            s.exit_eval     = double(it->second.exit_eval) / s.scored();
+            s.favored_score = s.exit_eval >= 0 ? s.white_score() : 1 - s.white_score();
+        }
+
+        if (s.scored() >= min_games)
+            s.flags = (s.draws == s.scored()                                ? ALWAYS_DRAWN : 0)
+                    | (s.white_score() >= 0.8 || s.white_score() <= 0.2     ? LOPSIDED     : 0)
+                    | (std::abs(s.exit_eval) >= 150 && s.favored_score >= 0.75 ? BOOK_EXIT : 0);
+
+        stats.push_back(s);
+    }
+
+    return stats;
+}
+
+size_t report_openings(const OpeningHistory& history, const std::vector<std::string>& fens, const std::string& report,
+                       const std::string& pruned, uint64_t min_games)
+{
+    std::vector<OpeningStats> stats = history.stats(fens, min_games);
+
+    size_t judged = 0, flagged = 0, counts[3] = {};
+
+    for (const OpeningStats& s : stats)
+    {
+        judged += s.scored() >= min_games;
+        flagged += s.flags != 0;
+
+        for (int f = 0; f < 3; f++)
+            counts[f] += (s.flags >> f) & 1;
+    }
+
+    if (!report.empty())
+    {
+        std::ofstream out(report);
+
+        out << "fen,games,white_wins,draws,black_wins,white_score,plies,checkmates,stalemates,repetitions,fifty_move,exit_eval,favored_score,flags\n";
+
+        for (const OpeningStats& s : stats)
+        {
+            std::string flags;
+
+            for (auto [flag, name] : { std::pair(ALWAYS_DRAWN, "always_drawn"), std::pair(LOPSIDED, "lopsided"), std::pair(BOOK_EXIT, "book_exit") })
+                if (s.flags & flag)
+                    flags += (flags.empty() ? "" : " ") + std::string(name);
+
+            out << s.fen << "," << s.games << "," << s.white_wins << "," << s.draws << "," << s.black_wins << ","
+                << s.white_score() << "," << s.plies << "," << s.ended[MATE] << "," << s.ended[STALEMATE] << ","
+                << s.ended[REPETITION] << "," << s.ended[FIFTY_MOVE] << "," << s.exit_eval << "," << s.favored_score << ","
+                << flags << "\n";
+        }
+
+        if (!out.flush())
+            std::cout << "Could not write " << report << std::endl;
+    }
+
+    // Openings without enough games stay in, nothing is known against them yet
+    if (!pruned.empty())
+    {
+        std::ofstream out(pruned);
+
+        for (const OpeningStats& s : stats)
+            if (!s.flags)
+                out << s.fen << "\n";
+
+        if (!out.flush())
+            std::cout << "Could not write " << pruned << std::endl;
+    }
+
+    std::cout << stats.size() << " openings, " << judged << " with " << min_games << " or more games: "
+              << counts[0] << " always drawn, " << counts[1] << " lopsided, " << counts[2] << " decided by book exit, "
+              << flagged << " flagged" << std::endl;
+
+    if (!pruned.empty())
+        std::cout << stats.size() - flagged << " openings written to " << pruned << std::endl;
+
+    return flagged;
+}
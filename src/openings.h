@@ -0,0 +1,86 @@
+
+#ifndef OPENINGS_H
+#define OPENINGS_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "position.h"
+
+// Reads one FEN per line and checks them all on 'threads' threads before anything is played.
+// Lines that are not a playable position are reported with their line number and left out
+std::vector<std::string> load_openings(const std::string& path, int threads);
+
+// How a game from an opening ended on the board. Games lost by a crash or time forfeit are
+// not recorded, they say nothing about the opening
+struct OpeningOutcome
+{
+    int       plies;
+    int       white_score;  // 1, 0 or -1
+    GameState state;
+    int       exit_eval;    // centipawns for white, the average of both engines' first score
+};
+
+enum OpeningFlag { ALWAYS_DRAWN = 1, LOPSIDED = 2, BOOK_EXIT = 4 };
+
+// What the history says about one opening of a suite. Flags are only set from min_games
+// scored games on: always drawn, one color scoring 80% or more, or the side that was 150 cp
+// or more ahead when the engines left the book scoring 75% or more
+struct OpeningStats
+{
+    std::string fen;
+    uint64_t    games;
+    uint64_t    white_wins;
+    uint64_t    black_wins;
+    uint64_t    draws;
+    uint64_t    ended[FIFTY_MOVE + 1];  // by GameState
+    double      plies;
+    double      exit_eval;
+    double      favored_score;          // of the side the average exit eval favors
+    int         flags;
+
+    uint64_t scored() const { return white_wins + black_wins + draws; }
+    double white_score() const { return scored() ? (white_wins + 0.5 * draws) / scored() : 0.5; }
+};
+
+// Games, plies and outcomes of every opening, kept across runs in a text file so that
+// openings that lead to long games can be started first, and uninformative ones found
+class OpeningHistory
+{
+public:
+    bool load(const std::string& path);
+    bool save(const std::string& path) const;
+
+    void   record(const std::string& fen, const OpeningOutcome& outcome);
+    double expected_plies(const std::string& fen) const;
+
+    std::vector<OpeningStats> stats(const std::vector<std::string>& fens, uint64_t min_games) const;
+
+private:
+    // Histories written before outcomes were kept only have games and plies
+    struct Entry
+    {
+        uint64_t games;
+        uint64_t plies;
+        uint64_t white_wins;
+        uint64_t black_wins;
+        uint64_t draws;
+        uint64_t ended[FIFTY_MOVE + 1];
+        int64_t  exit_eval;  // sum
+    };
+
+    mutable std::mutex                     mtx;
+    std::unordered_map<std::string, Entry> entries;
+    uint64_t                               games = 0;
+    uint64_t                               plies = 0;
+};
+
+// --openings_report writes the stats of every opening of the suite as CSV, --openings_prune
+// the suite without the flagged openings. Returns the # of flagged openings
+size_t report_openings(const OpeningHistory& history, const std::vector<std::string>& fens, const std::string& report,
+                       const std::string& pruned, uint64_t min_games);
+
+#endif
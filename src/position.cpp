@@ -1,293 +1,388 @@
-
-#include "position.h"
-
-#include <algorithm>
-#include <cstring>
-#include <iomanip>
-#include <random>
-#include <sstream>
-
-#include "bitboard.h"
-#include "uci.h"
-
-constexpr std::string_view piece_to_char = "  PNBRQK  pnbrqk";
-
-namespace Zobrist {
-    static uint64_t enpassant[SQUARE_NB];
-    static uint64_t Side = 0xeeb3b2fe864d41e5ull;
-    static uint64_t hash[B_KING + 1][SQUARE_NB];
-    static uint64_t castling[1 << 4];
-}
-
-uint64_t Position::hash() const
-{
-    uint64_t key = side_to_move() == WHITE ? 0 : Zobrist::Side;
-
-    for (Square sq = H1; sq <= A8; sq++)
-        key ^= Zobrist::hash[piece_on(sq)][sq];
-    
-    return key ^ Zobrist::castling[state_info.castling_rights]
-               ^ Zobrist::enpassant[state_info.ep_sq];
-}
-
-void Position::init()
-{
-    std::mt19937_64 rng(221564671644);
-
-    for (Piece pc : { W_PAWN, W_KNIGHT, W_BISHOP, W_ROOK, W_QUEEN, W_KING,
-                      B_PAWN, B_KNIGHT, B_BISHOP, B_ROOK, B_QUEEN, B_KING })
-    {
-        for (Square sq = H1; sq <= A8; sq++)
-            Zobrist::hash[pc][sq] = rng();
-    }
-
-    for (Square s = H1; s <= A8; s++)
-        Zobrist::enpassant[s] = rng();
-
-    for (int rights = 0; rights <= 0xf; rights++)
-        Zobrist::castling[rights] = rng();
-}
-
-Bitboard Position::checkers()
-{
-    Color us = side_to_move(), them = !us;
-
-    Square ksq = lsb(bb(make_piece(us, KING)));
-
-    return PawnAttacks[us][ksq]                &  bb(make_piece(them, PAWN))
-         | knight_attacks(ksq)                 &  bb(make_piece(them, KNIGHT))
-         | attacks_bb(BISHOP, ksq, occupied()) & (bb(make_piece(them, QUEEN)) | bb(make_piece(them, BISHOP)))
-         | attacks_bb(ROOK,   ksq, occupied()) & (bb(make_piece(them, QUEEN)) | bb(make_piece(them, ROOK)));
-}
-
-GameState Position::game_state()
-{
-    if (state_info.halfmove_clock >= 100)
-        return FIFTY_MOVE;
-
-    for (int i = 0, occurrences = 0; i < history.size(); i++)
-    {
-        if (history[i] == history.back())
-            occurrences++;
-
-        if (occurrences == 3)
-            return REPETITION;
-    }       
-    
-    if (Move list[MAX_MOVES], *end = get_moves(list); list == end) {
-        return checkers() ? MATE : STALEMATE;
-    }
-
-    return ONGOING;
-}
-
-void Position::do_move(Move m)
-{
-    Color us = state_info.side_to_move, them = !us;
-
-    Piece Pawn  = make_piece(us, PAWN);
-    Piece Rook  = make_piece(us, ROOK);
-    Piece Queen = make_piece(us, QUEEN);
-    Piece King  = make_piece(us, KING);
-
-    Square from = m.from_sq(), to = m.to_sq();
-
-    if (piece_on(from) == Pawn || piece_on(to))
-        state_info.halfmove_clock = 0;
-    else
-        state_info.halfmove_clock++;
-
-    state_info.ep_sq = NO_SQ;
-
-    if ((from ^ to) == 16 && piece_on(from) == Pawn)
-        if (Square potential_ep = to + relative_direction(us, SOUTH); PawnAttacks[us][potential_ep] & bitboards[make_piece(them, PAWN)]) state_info.ep_sq = potential_ep;
-
-    state_info.side_to_move = !state_info.side_to_move;
-
-    Bitboard zero_to = ~square_bb(to);
-    Bitboard from_to =  square_bb(from, to);
-
-    switch (m.type_of())
-    {
-    case NORMAL:
-        bitboards[board[to]] &= zero_to;
-        bitboards[them] &= zero_to;
-        bitboards[board[from]] ^= from_to;
-        bitboards[us] ^= from_to;
-
-        board[to] = board[from];
-        board[from] = NO_PIECE;
-
-        update_castling_rights(us);
-        
-        history.push_back(hash());
-        return;
-    case PROMOTION:
-    {
-        Piece promotion = make_piece(us, m.promotion_type());
-        
-        bitboards[board[to]] &= zero_to;
-        bitboards[them] &= zero_to;
-        bitboards[Pawn] ^= square_bb(from);
-        bitboards[promotion] ^= ~zero_to;
-        bitboards[us] ^= from_to;
-
-        board[to] = promotion;
-        board[from] = NO_PIECE;
-        
-        update_castling_rights(us);
-        
-        history.push_back(hash());
-        return;
-    }
-    case CASTLING:
-    {
-        Move rook_move = to == G1 ? Move(H1, F1)
-                       : to == C1 ? Move(A1, D1)
-                       : to == G8 ? Move(H8, F8) : Move(A8, D8);
-
-        Square rook_from = rook_move.from_sq(), rook_to = rook_move.to_sq();
-        Bitboard rook_from_to = square_bb(rook_from, rook_to);
-
-        bitboards[King] ^= from_to;
-        bitboards[Rook] ^= rook_from_to;
-        bitboards[us] ^= from_to ^ rook_from_to;
-
-        board[from] = NO_PIECE;
-        board[rook_from] = NO_PIECE;
-        board[to] = King;
-        board[rook_to] = Rook;
-
-        update_castling_rights(us);
-
-        history.push_back(hash());
-        return;
-    }
-    case ENPASSANT:
-        Piece EnemyPawn = make_piece(them, PAWN);
-
-        Square capsq = to + (us == WHITE ? SOUTH : NORTH);
-
-        bitboards[Pawn] ^= from_to;
-        bitboards[EnemyPawn] ^= square_bb(capsq);
-        bitboards[us] ^= from_to;
-        bitboards[them] ^= square_bb(capsq);
-
-        board[from] = NO_PIECE;
-        board[to] = Pawn;
-        board[capsq] = NO_PIECE;
-
-        history.push_back(hash());
-        return;
-    }
-}
-
-void Position::update_castling_rights(Color just_moved)
-{
-    Bitboard mask = just_moved == WHITE ? square_bb(A1, E1, H1, A8, H8) : square_bb(A8, E8, H8, A1, H1);
-    state_info.castling_rights &= castle_masks[just_moved][pext(bitboards[just_moved], mask)];
-}
-
-void Position::set(const std::string& fen)
-{
-    memset(board, NO_PIECE, sizeof(board));
-    memset(bitboards, 0ull, sizeof(bitboards));
-
-    Square             sq = A8;
-    std::istringstream is(fen);
-    std::string        pieces, color, castling, enpassant;
-
-    is >> pieces >> color >> castling >> enpassant;
-
-    for (char token : pieces)
-    {
-        if (std::isdigit(token))
-            sq -= token - '0'; 
-        else if (size_t piece = piece_to_char.find(token); piece != std::string::npos)
-        {
-            board[sq] = piece;
-            bitboards[piece] |= square_bb(sq);
-            bitboards[color_of(piece)] |= square_bb(sq);
-            sq--;
-        }
-    }
-
-    state_info.side_to_move = color == "w" ? WHITE : BLACK;
-
-    state_info.castling_rights = state_info.ep_sq = 0;
-
-    for (char token : castling)
-        if (size_t idx = std::string("qkQK").find(token); idx != std::string::npos)
-            state_info.castling_rights |= 1 << idx;
-
-    if (enpassant != "-")
-        state_info.ep_sq = uci_to_square(enpassant);
-
-    state_info.halfmove_clock = 0;
-
-    history.clear();
-    history.push_back(hash());
-}
-
-std::string Position::to_string() const
-{
-    std::stringstream ss;
-
-    ss << "\n+---+---+---+---+---+---+---+---+\n";
-
-    for (Square sq = A8; sq >= H1; sq--)
-    {
-        ss << "| " << piece_to_char[board[sq]] << " ";
-
-        if (sq % 8 == 0)
-            ss << "| " << (sq / 8 + 1) << "\n+---+---+---+---+---+---+---+---+\n";
-    }
-
-    ss << "  a   b   c   d   e   f   g   h\n\nFen: " << fen() << "\nKey: " << std::setw(16) << std::setfill('0') << std::hex << std::uppercase << hash() << "\n";
-
-    return ss.str();
-}
-
-std::string Position::fen() const
-{
-    std::stringstream fen;
-
-    for (int rank = 7; rank >= 0; rank--)
-    {
-        for (int file = 7; file >= 0; file--)
-        {
-            if (Piece pc = piece_on(rank * 8 + file))
-                fen << piece_to_char[pc];
-            else
-            {
-                int empty = 0, f;
-
-                for (f = file; f >= 0 && !piece_on(rank * 8 + f); f--)
-                    empty++;
-
-                fen << empty;
-
-                file = f + 1;
-            }
-        }
-
-        if (rank)
-            fen << "/";
-    }
-
-    fen << " " << "wb"[state_info.side_to_move] << " ";
-
-    if (!state_info.castling_rights)
-        fen << "-";
-    else
-    {
-        if (kingside_rights (WHITE)) fen << "K";
-        if (queenside_rights(WHITE)) fen << "Q";
-        if (kingside_rights (BLACK)) fen << "k";
-        if (queenside_rights(BLACK)) fen << "q";
-    }
-  
-    fen << " " << (state_info.ep_sq ? square_to_uci(state_info.ep_sq) : "-") << " " << (int)state_info.halfmove_clock;
-
-    return fen.str();
+
+#include "position.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#include "bitboard.h"
+#include "uci.h"
+
+constexpr std::string_view piece_to_char = "  PNBRQK  pnbrqk";
+
+namespace Zobrist {
+
+struct Keys
+{
+    uint64_t hash[B_KING + 1][SQUARE_NB];
+    uint64_t enpassant[SQUARE_NB];
+    uint64_t castling[1 << 4];
+};
+
+// xorshift64*, evaluated by the compiler so the keys are in read-only data
+constexpr Keys generate()
+{
+    Keys k{};
+    uint64_t s = 221564671644;
+
+    auto rand = [&]() {
+        s ^= s >> 12, s ^= s << 25, s ^= s >> 27;
+        return s * 2685821657736338717ull;
+    };
+
+    for (Piece pc : { W_PAWN, W_KNIGHT, W_BISHOP, W_ROOK, W_QUEEN, W_KING,
+                      B_PAWN, B_KNIGHT, B_BISHOP, B_ROOK, B_QUEEN, B_KING })
+    {
+        for (int sq = H1; sq <= A8; sq++)
+            k.hash[pc][sq] = rand();
+    }
+
+    for (int s = H1; s <= A8; s++)
+        k.enpassant[s] = rand();
+
+    for (int rights = 0; rights <= 0xf; rights++)
+        k.castling[rights] = rand();
+
+    return k;
+}
+
+constexpr Keys     keys      = generate();
+constexpr auto&    hash      = keys.hash;
+constexpr auto&    enpassant = keys.enpassant;
+constexpr auto&    castling  = keys.castling;
+constexpr uint64_t Side      = 0xeeb3b2fe864d41e5ull;
+
+}
+
+Bitboard Position::checkers()
+{
+    return attackers_to(lsb(bb(make_piece(side_to_move(), KING))), !side_to_move());
+}
+
+GameState Position::game_state()
+{
+    if (state_info.halfmove_clock >= 100)
+        return FIFTY_MOVE;
+
+    for (int i = 0, occurrences = 0; i < history.size(); i++)
+    {
+        if (history[i] == history.back())
+            occurrences++;
+
+        if (occurrences == 3)
+            return REPETITION;
+    }       
+    
+    if (Move list[MAX_MOVES], *end = get_moves(list); list == end) {
+        return checkers() ? MATE : STALEMATE;
+    }
+
+    return ONGOING;
+}
+
+// One instance per side and move type, so the pieces involved and the pawn direction are
+// constants, and the hash key is updated for the squares that changed instead of recomputed
+template<Color Us, MoveType Type>
+void Position::do_move(Move m)
+{
+    constexpr Color     Them      = !Us;
+    constexpr Piece     Pawn      = make_piece(Us,   PAWN);
+    constexpr Piece     EnemyPawn = make_piece(Them, PAWN);
+    constexpr Piece     Rook      = make_piece(Us,   ROOK);
+    constexpr Piece     King      = make_piece(Us,   KING);
+    constexpr Direction Up        = relative_direction(Us, NORTH);
+
+    Square from = m.from_sq(), to = m.to_sq();
+    Piece  pc = board[from], captured = board[to];
+
+    uint64_t key = state_info.key ^ Zobrist::Side
+                                  ^ Zobrist::castling[state_info.castling_rights]
+                                  ^ Zobrist::enpassant[state_info.ep_sq];
+
+    Bitboard zero_to = ~square_bb(to);
+    Bitboard from_to =  square_bb(from, to);
+
+    state_info.ep_sq = NO_SQ;
+
+    if constexpr (Type == NORMAL)
+    {
+        state_info.halfmove_clock = pc == Pawn || captured ? 0 : state_info.halfmove_clock + 1;
+
+        bitboards[captured] &= zero_to;
+        bitboards[Them] &= zero_to;
+        bitboards[pc] ^= from_to;
+        bitboards[Us] ^= from_to;
+
+        board[to] = pc;
+        board[from] = NO_PIECE;
+
+        key ^= Zobrist::hash[captured][to] ^ Zobrist::hash[pc][from] ^ Zobrist::hash[pc][to];
+
+        if (pc == Pawn && (from ^ to) == 16 && PawnAttacks[Us][to - Up] & bitboards[EnemyPawn])
+            state_info.ep_sq = to - Up;
+    }
+    else if constexpr (Type == PROMOTION)
+    {
+        Piece promotion = make_piece(Us, m.promotion_type());
+
+        state_info.halfmove_clock = 0;
+
+        bitboards[captured] &= zero_to;
+        bitboards[Them] &= zero_to;
+        bitboards[Pawn] ^= square_bb(from);
+        bitboards[promotion] ^= ~zero_to;
+        bitboards[Us] ^= from_to;
+
+        board[to] = promotion;
+        board[from] = NO_PIECE;
+
+        key ^= Zobrist::hash[captured][to] ^ Zobrist::hash[Pawn][from] ^ Zobrist::hash[promotion][to];
+    }
+    else if constexpr (Type == CASTLING)
+    {
+        // The king moves two squares towards the rook, which lands on the square it crossed
+        Square rook_from = to < from ? to - 1 : to + 2;
+        Square rook_to   = to < from ? to + 1 : to - 1;
+
+        Bitboard rook_from_to = square_bb(rook_from, rook_to);
+
+        state_info.halfmove_clock++;
+
+        bitboards[King] ^= from_to;
+        bitboards[Rook] ^= rook_from_to;
+        bitboards[Us] ^= from_to ^ rook_from_to;
+
+        board[from] = NO_PIECE;
+        board[rook_from] = NO_PIECE;
+        board[to] = King;
+        board[rook_to] = Rook;
+
+        key ^= Zobrist::hash[King][from] ^ Zobrist::hash[King][to]
+             ^ Zobrist::hash[Rook][rook_from] ^ Zobrist::hash[Rook][rook_to];
+    }
+    else if constexpr (Type == ENPASSANT)
+    {
+        Square capsq = to - Up;
+
+        state_info.halfmove_clock = 0;
+
+        bitboards[Pawn] ^= from_to;
+        bitboards[EnemyPawn] ^= square_bb(capsq);
+        bitboards[Us] ^= from_to;
+        bitboards[Them] ^= square_bb(capsq);
+
+        board[from] = NO_PIECE;
+        board[to] = Pawn;
+        board[capsq] = NO_PIECE;
+
+        key ^= Zobrist::hash[Pawn][from] ^ Zobrist::hash[Pawn][to] ^ Zobrist::hash[EnemyPawn][capsq];
+    }
+
+    state_info.castling_rights &= CastlingMask[from] & CastlingMask[to];
+    state_info.side_to_move = Them;
+
+    state_info.key = key ^ Zobrist::castling[state_info.castling_rights]
+                         ^ Zobrist::enpassant[state_info.ep_sq];
+
+    history.push_back(state_info.key);
+}
+
+void Position::do_move(Move m)
+{
+    switch (m.type_of())
+    {
+    case NORMAL:    return white_to_move() ? do_move<WHITE, NORMAL   >(m) : do_move<BLACK, NORMAL   >(m);
+    case PROMOTION: return white_to_move() ? do_move<WHITE, PROMOTION>(m) : do_move<BLACK, PROMOTION>(m);
+    case CASTLING:  return white_to_move() ? do_move<WHITE, CASTLING >(m) : do_move<BLACK, CASTLING >(m);
+    case ENPASSANT: return white_to_move() ? do_move<WHITE, ENPASSANT>(m) : do_move<BLACK, ENPASSANT>(m);
+    }
+}
+
+// Parsed in place, starting a game does not allocate. Returns false if the text is not a
+// FEN; validate() checks whether the position it describes can be played from
+bool Position::set(std::string_view fen)
+{
+    memset(board, NO_PIECE, sizeof(board));
+    memset(bitboards, 0ull, sizeof(bitboards));
+
+    state_info = {};
+    history.clear();
+
+    auto field = [&]() {
+        size_t begin = std::min(fen.size(), fen.find_first_not_of(" \t\r\n"));
+        size_t end   = std::min(fen.size(), fen.find_first_of(" \t\r\n", begin));
+
+        std::string_view f = fen.substr(begin, end - begin);
+        fen.remove_prefix(end);
+
+        return f;
+    };
+
+    std::string_view pieces = field(), color = field(), castling = field(), enpassant = field();
+
+    int sq = A8, file = 0, rank = 7;
+
+    for (char token : pieces)
+    {
+        if (token >= '1' && token <= '8' && file + token - '0' <= 8)
+        {
+            sq   -= token - '0';
+            file += token - '0';
+        }
+        else if (token == '/' && file == 8 && rank > 0)
+        {
+            file = 0;
+            rank--;
+        }
+        else if (size_t piece = piece_to_char.find(token); piece != std::string_view::npos && token != ' ' && file < 8)
+        {
+            board[sq] = piece;
+            bitboards[piece] |= square_bb(sq);
+            bitboards[color_of(piece)] |= square_bb(sq);
+            sq--;
+            file++;
+        }
+        else
+            return false;
+    }
+
+    if (file != 8 || rank != 0 || (color != "w" && color != "b") || castling.empty())
+        return false;
+
+    state_info.side_to_move = color == "w" ? WHITE : BLACK;
+
+    for (char token : castling)
+        if (size_t idx = std::string_view("qkQK").find(token); idx != std::string_view::npos)
+            state_info.castling_rights |= 1 << idx;
+        else if (castling != "-")
+            return false;
+
+    if (enpassant.size() == 2 && enpassant[0] >= 'a' && enpassant[0] <= 'h' && (enpassant[1] == '3' || enpassant[1] == '6'))
+        state_info.ep_sq = uci_to_square(enpassant);
+    else if (enpassant != "-")
+        return false;
+
+    // The halfmove clock and move number are optional and not used, games start at 0
+    for (std::string_view counter = field(); !counter.empty(); counter = field())
+        if (counter.find_first_not_of("0123456789") != std::string_view::npos)
+            return false;
+
+    // Rights without the king and rook on their squares are dropped, do_move only clears them
+    // when a piece moves from or to one of those squares
+    for (Square s : { E1, H1, A1, E8, H8, A8 })
+        if (board[s] != (s == E1 ? W_KING : s == E8 ? B_KING : s <= A1 ? W_ROOK : B_ROOK))
+            state_info.castling_rights &= CastlingMask[s];
+
+    state_info.key = state_info.side_to_move == WHITE ? 0 : Zobrist::Side;
+
+    for (Square s = H1; s <= A8; s++)
+        state_info.key ^= Zobrist::hash[board[s]][s];
+
+    state_info.key ^= Zobrist::castling[state_info.castling_rights]
+                    ^ Zobrist::enpassant[state_info.ep_sq];
+
+    history.push_back(state_info.key);
+
+    return true;
+}
+
+Bitboard Position::attackers_to(Square sq, Color by) const
+{
+    return PawnAttacks[!by][sq]                &  bb(make_piece(by, PAWN))
+         | knight_attacks(sq)                  &  bb(make_piece(by, KNIGHT))
+         | king_attacks(sq)                    &  bb(make_piece(by, KING))
+         | attacks_bb(BISHOP, sq, occupied())  & (bb(make_piece(by, QUEEN)) | bb(make_piece(by, BISHOP)))
+         | attacks_bb(ROOK,   sq, occupied())  & (bb(make_piece(by, QUEEN)) | bb(make_piece(by, ROOK)));
+}
+
+const char *Position::validate() const
+{
+    Color     us = side_to_move(), them = !us;
+    Direction up = relative_direction(us, NORTH);
+
+    if (popcount(bb(W_KING)) != 1 || popcount(bb(B_KING)) != 1)
+        return "each side needs exactly one king";
+
+    if ((bb(W_PAWN) | bb(B_PAWN)) & (RANK_1 | RANK_8))
+        return "pawn on the first or last rank";
+
+    if (popcount(bb(WHITE)) > 16 || popcount(bb(BLACK)) > 16 || popcount(bb(W_PAWN)) > 8 || popcount(bb(B_PAWN)) > 8)
+        return "too many pieces";
+
+    if (attackers_to(lsb(bb(make_piece(them, KING))), us))
+        return "the side not to move is in check";
+
+    if (Square ep = ep_sq(); ep && (   rank_of(ep) != (us == WHITE ? RANK_6_ENUM : RANK_3_ENUM)
+                                    || piece_on(ep) || piece_on(ep + up)
+                                    || piece_on(ep - up) != make_piece(them, PAWN)))
+        return "impossible en passant square";
+
+    if (Move list[MAX_MOVES]; get_moves(list) == list)
+        return "no legal moves";
+
+    return nullptr;
+}
+
+std::string Position::to_string() const
+{
+    std::stringstream ss;
+
+    ss << "\n+---+---+---+---+---+---+---+---+\n";
+
+    for (Square sq = A8; sq >= H1; sq--)
+    {
+        ss << "| " << piece_to_char[board[sq]] << " ";
+
+        if (sq % 8 == 0)
+            ss << "| " << (sq / 8 + 1) << "\n+---+---+---+---+---+---+---+---+\n";
+    }
+
+    ss << "  a   b   c   d   e   f   g   h\n\nFen: " << fen() << "\nKey: " << std::setw(16) << std::setfill('0') << std::hex << std::uppercase << hash() << "\n";
+
+    return ss.str();
+}
+
+std::string Position::fen() const
+{
+    std::stringstream fen;
+
+    for (int rank = 7; rank >= 0; rank--)
+    {
+        for (int file = 7; file >= 0; file--)
+        {
+            if (Piece pc = piece_on(rank * 8 + file))
+                fen << piece_to_char[pc];
+            else
+            {
+                int empty = 0, f;
+
+                for (f = file; f >= 0 && !piece_on(rank * 8 + f); f--)
+                    empty++;
+
+                fen << empty;
+
+                file = f + 1;
+            }
+        }
+
+        if (rank)
+            fen << "/";
+    }
+
+    fen << " " << "wb"[state_info.side_to_move] << " ";
+
+    if (!state_info.castling_rights)
+        fen << "-";
+    else
+    {
+        if (kingside_rights (WHITE)) fen << "K";
+        if (queenside_rights(WHITE)) fen << "Q";
+        if (kingside_rights (BLACK)) fen << "k";
+        if (queenside_rights(BLACK)) fen << "q";
+    }
+  
+    fen << " " << (state_info.ep_sq ? square_to_uci(state_info.ep_sq) : "-") << " " << (int)state_info.halfmove_clock;
+
+    return fen.str();
 }
\ No newline at end of file
@@ -1,75 +1,83 @@
-
-#ifndef POSITION_H
-#define POSITION_H
-
-#include <string>
-#include <vector>
-
-#include "bitboard.h"
-#include "types.h"
-
-constexpr int MAX_MOVES = 128;
-
-enum GameState {
-    ONGOING,
-    MATE,
-    STALEMATE,
-    REPETITION,
-    FIFTY_MOVE,
-};
-
-struct StateInfo {
-    Square  ep_sq;
-    uint8_t castling_rights;
-    Color   side_to_move;
-    uint8_t halfmove_clock;
-};
-
-class Position
-{
-public:
-    Position() { set(); }
-
-    static void init();
-
-    Move *get_moves(Move *list) const;
-
-    void set(const std::string& fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
-    void do_move(Move m);
-    std::string fen() const;
-    std::string to_string() const;
-    GameState game_state();
-    uint64_t hash() const;
-    Bitboard checkers();
-
-    bool kingside_rights  (Color Perspective) const { return state_info.castling_rights & (Perspective == WHITE ? 0b1000 : 0b0010); }
-    bool queenside_rights (Color Perspective) const { return state_info.castling_rights & (Perspective == WHITE ? 0b0100 : 0b0001); }
-
-    bool white_to_move() const { return state_info.side_to_move == WHITE; }
-    bool black_to_move() const { return state_info.side_to_move == BLACK; }
-
-    Color side_to_move() const { return state_info.side_to_move; }
-
-    Piece piece_on(Square sq) const { return board[sq]; }
-
-    PieceType piece_type_on(Square sq) const { return type_of(board[sq]); }
-
-    Bitboard bb(Piece pc) const { return bitboards[pc]; }
-
-    Bitboard occupied() const { return bitboards[WHITE] | bitboards[BLACK]; }
-
-    Bitboard ep_bb() const { return square_bb(state_info.ep_sq); }
-
-    Square ep_sq() const { return state_info.ep_sq; }
-    
-private:
-    Bitboard bitboards[16];
-    Piece board[SQUARE_NB];
-
-    StateInfo state_info;
-    std::vector<uint64_t> history;
-
-    void update_castling_rights(Color just_moved);
-};
-
+
+#ifndef POSITION_H
+#define POSITION_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bitboard.h"
+#include "types.h"
+
+constexpr int MAX_MOVES = 128;
+
+enum GameState {
+    ONGOING,
+    MATE,
+    STALEMATE,
+    REPETITION,
+    FIFTY_MOVE,
+};
+
+struct StateInfo {
+    uint64_t key;
+    Square  ep_sq;
+    uint8_t castling_rights;
+    Color   side_to_move;
+    uint8_t halfmove_clock;
+};
+
+class Position
+{
+public:
+    Position() { set(); }
+
+    Move *get_moves(Move *list) const;
+
+    bool set(std::string_view fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+    const char *validate() const;  // why no game can be played from the position, or nullptr
+    void do_move(Move m);
+    std::string fen() const;
+    std::string to_string() const;
+    GameState game_state();
+    uint64_t hash() const { return state_info.key; }
+    Bitboard checkers();
+
+    bool kingside_rights  (Color Perspective) const { return state_info.castling_rights & (Perspective == WHITE ? 0b1000 : 0b0010); }
+    bool queenside_rights (Color Perspective) const { return state_info.castling_rights & (Perspective == WHITE ? 0b0100 : 0b0001); }
+
+    bool white_to_move() const { return state_info.side_to_move == WHITE; }
+    bool black_to_move() const { return state_info.side_to_move == BLACK; }
+
+    Color side_to_move() const { return state_info.side_to_move; }
+
+    Piece piece_on(Square sq) const { return board[sq]; }
+
+    PieceType piece_type_on(Square sq) const { return type_of(board[sq]); }
+
+    Bitboard bb(Piece pc) const { return bitboards[pc]; }
+
+    Bitboard occupied() const { return bitboards[WHITE] | bitboards[BLACK]; }
+
+    Bitboard ep_bb() const { return square_bb(state_info.ep_sq); }
+
+    Square ep_sq() const { return state_info.ep_sq; }
+
+    uint8_t castling_rights() const { return state_info.castling_rights; }
+
+    uint8_t halfmove_clock() const { return state_info.halfmove_clock; }
+    
+private:
+    Bitboard bitboards[16];
+    Piece board[SQUARE_NB];
+
+    StateInfo state_info;
+    std::vector<uint64_t> history;
+
+    Bitboard attackers_to(Square sq, Color by) const;
+
+    template<Color Us, MoveType Type>
+    void do_move(Move m);
+};
+
 #endif
\ No newline at end of file
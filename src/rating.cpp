@@ -0,0 +1,156 @@
+
+#include "rating.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <thread>
+
+namespace {
+
+struct Counts
+{
+    int    a, b;
+    double a_wins, b_wins, draws;
+};
+
+// Every pairing that has been played gets one virtual draw, so that an engine
+// that never scored against anybody still gets a finite rating
+constexpr double Prior = 1.0;
+
+int fit(int engines, const std::vector<Counts>& counts, std::vector<double>& gamma, double& nu)
+{
+    std::vector<double> score(engines, 0.0), denom(engines), next(engines);
+    double draws = 0;
+
+    for (const Counts& c : counts)
+    {
+        score[c.a] += 2 * c.a_wins + c.draws + Prior;
+        score[c.b] += 2 * c.b_wins + c.draws + Prior;
+        draws      += c.draws + Prior;
+    }
+
+    int iter;
+
+    for (iter = 1; iter <= 100000; iter++)
+    {
+        std::fill(denom.begin(), denom.end(), 0.0);
+
+        double nu_denom = 0;
+
+        for (const Counts& c : counts)
+        {
+            double n    = c.a_wins + c.b_wins + c.draws + Prior;
+            double root = std::sqrt(gamma[c.a] * gamma[c.b]);
+            double d    = gamma[c.a] + gamma[c.b] + nu * root;
+
+            denom[c.a] += n * (2 + nu * std::sqrt(gamma[c.b] / gamma[c.a])) / d;
+            denom[c.b] += n * (2 + nu * std::sqrt(gamma[c.a] / gamma[c.b])) / d;
+            nu_denom   += n * root / d;
+        }
+
+        double log_mean = 0, delta = 0;
+
+        for (int i = 0; i < engines; i++)
+        {
+            next[i] = denom[i] > 0 ? score[i] / denom[i] : gamma[i];
+            log_mean += std::log(next[i]) / engines;
+        }
+
+        for (int i = 0; i < engines; i++)
+        {
+            next[i] /= std::exp(log_mean);
+            delta = std::max(delta, std::abs(std::log(next[i] / gamma[i])));
+        }
+
+        gamma.swap(next);
+        nu = nu_denom > 0 ? draws / nu_denom : nu;
+
+        if (delta < 1e-10)
+            break;
+    }
+
+    return iter;
+}
+
+std::vector<double> to_elo(const std::vector<double>& gamma)
+{
+    std::vector<double> elo;
+
+    for (double g : gamma)
+        elo.push_back(400 * std::log10(g));
+
+    return elo;
+}
+
+}
+
+Ratings compute_ratings(int engines, const std::vector<Pairing>& pairings, int bootstrap, int threads)
+{
+    std::vector<Counts> counts;
+
+    for (const Pairing& p : pairings)
+        if (p.first_wins + p.second_wins + p.draws)
+            counts.push_back({ p.first, p.second, double(p.first_wins), double(p.second_wins), double(p.draws) });
+
+    Ratings r;
+    std::vector<double> gamma(engines, 1.0);
+
+    r.draw_nu    = 1.0;
+    r.iterations = fit(engines, counts, gamma, r.draw_nu);
+    r.elo        = to_elo(gamma);
+    r.margin.assign(engines, 0.0);
+
+    if (bootstrap <= 0 || counts.empty())
+        return r;
+
+    std::vector<std::vector<double>> samples(bootstrap);
+    std::vector<std::thread> thread_pool;
+
+    threads = std::clamp(threads, 1, bootstrap);
+
+    for (int t = 0; t < threads; t++)
+        thread_pool.emplace_back([&, t]() {
+            std::mt19937_64 rng(0x9e3779b97f4a7c15ull * (t + 1));
+            std::vector<Counts> resampled = counts;
+
+            for (int s = t; s < bootstrap; s += threads)
+            {
+                for (size_t i = 0; i < counts.size(); i++)
+                {
+                    const Counts& c = counts[i];
+                    int n = c.a_wins + c.b_wins + c.draws;
+
+                    int wins  = std::binomial_distribution<int>(n, c.a_wins / n)(rng);
+                    int draws = n - wins ? std::binomial_distribution<int>(n - wins, std::min(1.0, c.draws / (n - c.a_wins)))(rng) : 0;
+
+                    resampled[i].a_wins = wins;
+                    resampled[i].draws  = draws;
+                    resampled[i].b_wins = n - wins - draws;
+                }
+
+                std::vector<double> g = gamma;
+                double nu = r.draw_nu;
+
+                fit(engines, resampled, g, nu);
+                samples[s] = to_elo(g);
+            }
+        });
+
+    for (std::thread& thread : thread_pool)
+        thread.join();
+
+    for (int i = 0; i < engines; i++)
+    {
+        std::vector<double> elo;
+
+        for (const std::vector<double>& s : samples)
+            elo.push_back(s[i]);
+
+        std::sort(elo.begin(), elo.end());
+
+        r.margin[i] = (elo[int(0.975 * (bootstrap - 1))] - elo[int(0.025 * (bootstrap - 1))]) / 2;
+    }
+
+    return r;
+}
@@ -0,0 +1,22 @@
+
+#ifndef RATING_H
+#define RATING_H
+
+#include <vector>
+
+#include "tournament.h"
+
+struct Ratings
+{
+    std::vector<double> elo;
+    std::vector<double> margin;
+    double              draw_nu;
+    int                 iterations;
+};
+
+// Maximum likelihood ratings under the Davidson draw model, fitted with Hunter's
+// MM iteration. Error margins are 95% intervals from a parametric bootstrap of every
+// pairing's W/D/L counts, spread over 'threads' threads.
+Ratings compute_ratings(int engines, const std::vector<Pairing>& pairings, int bootstrap = 1000, int threads = 1);
+
+#endif
@@ -0,0 +1,238 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define NOMINMAX
+
+#include "recording.h"
+
+#include <filesystem>
+#include <iostream>
+#include <iterator>
+#include <string_view>
+
+#include "engine.h"
+
+namespace {
+
+const char Header[] = "MMREC 1\n";
+
+void put_varint(std::string& out, uint64_t v)
+{
+    for (; v >= 0x80; v >>= 7)
+        out += char(v | 0x80);
+
+    out += char(v);
+}
+
+bool get_varint(std::string_view& in, uint64_t& v)
+{
+    v = 0;
+
+    for (int shift = 0; !in.empty() && shift < 64; shift += 7)
+    {
+        uint8_t b = in.front();
+        in.remove_prefix(1);
+        v |= uint64_t(b & 0x7f) << shift;
+
+        if (!(b & 0x80))
+            return true;
+    }
+
+    return false;
+}
+
+}
+
+Recorder::Recorder(const std::string& path, bool flush) : out(path, std::ios::binary), last(std::chrono::steady_clock::now()), m_flush(flush)
+{
+    if (!out)
+        std::cout << "Could not write " << path << std::endl;
+
+    out << Header;
+}
+
+Recorder::~Recorder()
+{
+    out << buffer;
+}
+
+void Recorder::record(RecordType type, const char *data, size_t size)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+
+    auto now = std::chrono::steady_clock::now();
+
+    buffer += char(type);
+    put_varint(buffer, std::chrono::duration_cast<std::chrono::microseconds>(now - last).count());
+    put_varint(buffer, size);
+    buffer.append(data, size);
+
+    last = now;
+
+    // Inputs go out with the output that answers them, which is every move without --low_latency
+    if (type != REC_INPUT && (m_flush || buffer.size() >= 1 << 16))
+    {
+        out << buffer;
+        out.flush();
+        buffer.clear();
+    }
+}
+
+bool Replay::load(const std::vector<std::string>& paths)
+{
+    size_t files = 0;
+
+    for (const std::string& path : paths)
+    {
+        std::error_code ec;
+
+        if (std::filesystem::is_directory(path, ec))
+        {
+            // A match recorded into the directory, the first one given counts
+            if (std::ifstream in(path + "\\seeds.txt"); in && seeds.empty())
+                for (uint64_t seed; in >> seed;)
+                    seeds.push_back(seed);
+
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(path, ec))
+                if (entry.is_regular_file() && entry.path().extension() == ".rec")
+                    files += load_file(entry.path().string());
+        }
+        else
+            files += load_file(path);
+    }
+
+    std::cout << answers.size() << " recorded answers to 'go' in " << by_position.size() << " positions, from " << files << " recordings" << std::endl;
+
+    return !answers.empty();
+}
+
+// Splits the recorded inputs into lines to follow the position each 'go' was for, and collects
+// the outputs after it until the line with bestmove is complete or the engine is gone
+bool Replay::load_file(const std::string& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    std::string   bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    if (bytes.compare(0, sizeof(Header) - 1, Header) != 0)
+    {
+        std::cout << "Not a recording: " << path << std::endl;
+        return false;
+    }
+
+    std::string_view rest(bytes);
+    rest.remove_prefix(sizeof(Header) - 1);
+
+    std::string engine, game, position, line, output;
+    Answer      answer;
+    bool        pending = false;
+    uint64_t    since = 0;
+
+    auto finish = [&](RecordType end) {
+        answer.end = end;
+        answers.push_back(std::move(answer));
+        by_engine[engine + "\n" + position].list.push_back(&answers.back());
+
+        if (!game.empty())
+            by_game[engine + "\n" + game + "\n" + position].list.push_back(&answers.back());
+
+        by_position[position].list.push_back(&answers.back());
+        answer  = Answer();
+        pending = false;
+    };
+
+    while (!rest.empty())
+    {
+        RecordType type = RecordType(rest.front());
+        uint64_t   delay, size;
+
+        rest.remove_prefix(1);
+
+        // A recording cut off by a crash ends with a partial event, everything before it counts
+        if (!get_varint(rest, delay) || !get_varint(rest, size) || size > rest.size())
+            break;
+
+        std::string_view data = rest.substr(0, size);
+        rest.remove_prefix(size);
+
+        since += delay;
+
+        if (type == REC_SPAWN)
+        {
+            engine = engine_name(std::string(data));
+            game.clear();
+            line.clear();
+            pending = false;
+        }
+        else if (type == REC_GAME)
+            game = data;
+        else if (type == REC_INPUT)
+        {
+            for (char c : data)
+            {
+                if (c != '\n')
+                {
+                    line += c;
+                    continue;
+                }
+
+                if (!line.empty() && line.back() == '\r')
+                    line.pop_back();
+
+                if (line.rfind("position ", 0) == 0)
+                    position = line;
+                else if (line.rfind("go", 0) == 0 && !pending)
+                {
+                    pending = true;
+                    output.clear();
+                    since = 0;
+                }
+
+                line.clear();
+            }
+        }
+        else if (type == REC_OUTPUT && pending)
+        {
+            answer.chunks.push_back({ since, std::string(data) });
+            since = 0;
+            output += data;
+
+            if (size_t bestmove = output.find("bestmove"); bestmove != std::string::npos && output.find('\n', bestmove) != std::string::npos)
+                finish(REC_OUTPUT);
+        }
+        else if ((type == REC_EXIT || type == REC_TIMEOUT) && pending)
+            finish(type);
+    }
+
+    return true;
+}
+
+const Replay::Answer *Replay::answer(const std::string& engine, const std::string& game, const std::string& position)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+
+    Answers *a = nullptr;
+
+    if (auto it = by_game.find(engine + "\n" + game + "\n" + position); it != by_game.end())
+        a = &it->second;
+    else if (auto it = by_engine.find(engine + "\n" + position); it != by_engine.end())
+        a = &it->second;
+
+    if (!a)
+    {
+        missed++;
+        other_engine += by_position.count(position);
+        return nullptr;
+    }
+
+    answered++;
+
+    return a->list[a->next++ % a->list.size()];
+}
+
+bool save_seeds(const std::string& path, const std::vector<uint64_t>& seeds)
+{
+    std::ofstream out(path);
+
+    for (uint64_t seed : seeds)
+        out << seed << "\n";
+
+    return bool(out);
+}
@@ -0,0 +1,100 @@
+
+#ifndef RECORDING_H
+#define RECORDING_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// What happened on the pipes of an engine process. A recording is the header line
+// "MMREC 1\n" and then one event after the other: the type byte, the microseconds since the
+// previous event and the length of the data as LEB128 varints, and the data
+enum RecordType : uint8_t
+{
+    REC_SPAWN,    // data is the engine path
+    REC_INPUT,    // bytes written to the engine in one write
+    REC_OUTPUT,   // bytes read from the engine in one read
+    REC_EXIT,     // stdout was closed
+    REC_TIMEOUT,  // the watchdog terminated the engine
+    REC_GAME,     // data identifies the game that starts, so a replay can answer it from the same game
+};
+
+// --record: one file per Engine object, written by its writer thread, its game thread and
+// the watchdog. Outputs are flushed as they come unless flush is off (--low_latency), so a
+// recording survives a crash of MatchManager
+class Recorder
+{
+public:
+    Recorder(const std::string& path, bool flush);
+   ~Recorder();
+
+    void record(RecordType type, const char *data = nullptr, size_t size = 0);
+
+private:
+    std::mutex                            mtx;
+    std::ofstream                         out;
+    std::string                           buffer;
+    std::chrono::steady_clock::time_point last;
+    bool                                  m_flush;
+};
+
+// --replay: the answers to 'go' in every position of a set of recordings. An Engine replaying
+// them starts no process and answers each 'go' with the output its engine gave to the same
+// position command in the same game, or, for a game the recordings do not have, in any game
+// with each recording in turn. Another engine's answer is never used: a position the engine
+// was not recorded in is a replay error
+class Replay
+{
+public:
+    struct Chunk
+    {
+        uint64_t    delay;  // microseconds since 'go' or the chunk before
+        std::string data;
+    };
+
+    struct Answer
+    {
+        std::vector<Chunk> chunks;
+        RecordType         end;  // REC_OUTPUT when bestmove came, REC_EXIT or REC_TIMEOUT when it did not
+    };
+
+    bool load(const std::vector<std::string>& paths);
+
+    // nullptr if the engine was not recorded in the position
+    const Answer *answer(const std::string& engine, const std::string& game, const std::string& position);
+
+    double speed = 0;  // recorded delays are divided by it, 0 for none
+
+    std::vector<uint64_t> seeds;  // of the passes of a recorded match, from seeds.txt
+
+    std::atomic<uint64_t> answered {};
+    std::atomic<uint64_t> missed {};
+    std::atomic<uint64_t> other_engine {};  // of the missed, those recorded only for other engines
+
+private:
+    struct Answers
+    {
+        std::vector<const Answer*> list;
+        size_t                     next = 0;
+    };
+
+    bool load_file(const std::string& path);
+
+    std::mutex                               mtx;
+    std::deque<Answer>                       answers;
+    std::unordered_map<std::string, Answers> by_game;      // engine name, game, position command
+    std::unordered_map<std::string, Answers> by_engine;    // engine name, newline, position command
+    std::unordered_map<std::string, Answers> by_position;
+};
+
+// --record of a match writes the seeds of its passes to seeds.txt in the recording directory,
+// --replay of that directory plays the same passes, so every game has its opening and colors
+bool save_seeds(const std::string& path, const std::vector<uint64_t>& seeds);
+
+#endif
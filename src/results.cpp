@@ -0,0 +1,139 @@
+
+#include "results.h"
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+std::string json(const Histogram& h)
+{
+    std::ostringstream ss;
+
+    ss << "{ \"count\": " << h.count()
+       << ", \"mean\": "  << h.mean()
+       << ", \"p50\": "   << h.percentile(50)
+       << ", \"p90\": "   << h.percentile(90)
+       << ", \"p99\": "   << h.percentile(99)
+       << ", \"p999\": "  << h.percentile(99.9)
+       << ", \"max\": "   << h.max() << " }";
+
+    return ss.str();
+}
+
+std::string json(const SearchStat& s)
+{
+    std::ostringstream ss;
+
+    ss << "{ \"count\": " << s.hist.count()
+       << ", \"mean\": "  << s.moments.mean
+       << ", \"sd\": "    << s.moments.stddev()
+       << ", \"p10\": "   << s.hist.percentile(10)
+       << ", \"p50\": "   << s.hist.percentile(50)
+       << ", \"p90\": "   << s.hist.percentile(90)
+       << ", \"max\": "   << s.hist.max() << " }";
+
+    return ss.str();
+}
+
+std::string escape(const std::string& s)
+{
+    std::string out;
+
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        out += c;
+    }
+
+    return out;
+}
+
+}
+
+void print_summary(const std::vector<EngineSummary>& engines)
+{
+    printf("\n");
+
+    for (const EngineSummary& e : engines)
+        e.times.print(e.name);
+
+    printf("\n");
+
+    bool search = false;
+
+    for (const EngineSummary& e : engines)
+    {
+        e.search.print(e.name);
+        search = search || e.search.depth.hist.count();
+    }
+
+    // Mean nps of the first engine relative to the second, with a 95% interval from the
+    // standard errors of both means, so a change in speed is seen next to the change in Elo
+    if (engines.size() == 2 && engines[0].search.nps.moments.n > 1 && engines[1].search.nps.moments.n > 1 && engines[1].search.nps.moments.mean > 0)
+    {
+        const RunningStats& a = engines[0].search.nps.moments;
+        const RunningStats& b = engines[1].search.nps.moments;
+
+        double ratio = a.mean / b.mean;
+        double error = ratio * std::sqrt(a.variance() / a.n / (a.mean * a.mean) + b.variance() / b.n / (b.mean * b.mean));
+
+        printf("%s nps is %.2f%% (+/- %.2f%%) of %s\n", engines[0].name.c_str(), 100 * ratio, 196 * error, engines[1].name.c_str());
+    }
+
+    if (search)
+        printf("\n");
+
+    for (const EngineSummary& e : engines)
+        e.usage.print(e.name);
+}
+
+bool write_results(const std::string& path, const std::vector<EngineSummary>& engines)
+{
+    std::ofstream out(path);
+
+    out << "{\n  \"engines\": [\n";
+
+    for (size_t i = 0; i < engines.size(); i++)
+    {
+        const EngineSummary& e = engines[i];
+
+        out << "    {\n"
+            << "      \"name\": \""           << escape(e.name)           << "\",\n";
+
+        if (e.tried)
+            out << "      \"tried\": "            << e.tried                  << ",\n"
+                << "      \"solved\": "           << e.solved                 << ",\n"
+                << "      \"failed\": "           << e.failed                 << ",\n"
+                << "      \"solve_ms\": "         << json(e.solve_ms)         << ",\n"
+                << "      \"solve_nodes\": "      << json(e.solve_nodes)      << ",\n";
+        else
+            out << "      \"wins\": "             << e.wins                   << ",\n"
+                << "      \"losses\": "           << e.losses                 << ",\n"
+                << "      \"draws\": "            << e.draws                  << ",\n";
+
+        out << "      \"think_us\": "         << json(e.times.think)      << ",\n"
+            << "      \"overshoot_us\": "     << json(e.times.overshoot)  << ",\n"
+            << "      \"turnaround_us\": "    << json(e.times.turnaround) << ",\n"
+            << "      \"cpu_wall_percent\": " << json(e.times.cpu_load)   << ",\n"
+            << "      \"depth\": "            << json(e.search.depth)     << ",\n"
+            << "      \"seldepth\": "         << json(e.search.seldepth)  << ",\n"
+            << "      \"nodes\": "            << json(e.search.nodes)     << ",\n"
+            << "      \"nps\": "              << json(e.search.nps)       << ",\n"
+            << "      \"hashfull\": "         << json(e.search.hashfull)  << ",\n"
+            << "      \"time_ms\": "          << json(e.search.time)      << ",\n"
+            << "      \"cpu_user_s\": "       << e.usage.user_seconds     << ",\n"
+            << "      \"cpu_kernel_s\": "     << e.usage.kernel_seconds   << ",\n"
+            << "      \"peak_working_set\": " << e.usage.peak_working_set << ",\n"
+            << "      \"peak_commit\": "      << e.usage.peak_commit      << ",\n"
+            << "      \"page_faults\": "      << e.usage.page_faults      << ",\n"
+            << "      \"processes\": "        << e.usage.processes        << "\n"
+            << "    }" << (i + 1 < engines.size() ? "," : "") << "\n";
+    }
+
+    out << "  ]\n}\n";
+
+    return bool(out);
+}
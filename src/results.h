@@ -0,0 +1,31 @@
+
+#ifndef RESULTS_H
+#define RESULTS_H
+
+#include <string>
+#include <vector>
+
+#include "engine.h"
+
+struct EngineSummary
+{
+    std::string   name;
+    int           wins;
+    int           losses;
+    int           draws;
+    MoveTimes     times;
+    SearchStats   search;
+    ResourceUsage usage;
+
+    // --epd: test positions instead of games, written in place of the game results
+    uint64_t      tried  = 0;
+    uint64_t      solved = 0;
+    uint64_t      failed = 0;  // timeouts and crashes
+    Histogram     solve_ms;    // time to solution
+    Histogram     solve_nodes; // nodes to solution, when the engine reports them
+};
+
+void print_summary(const std::vector<EngineSummary>& engines);
+bool write_results(const std::string& path, const std::vector<EngineSummary>& engines);
+
+#endif
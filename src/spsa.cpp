@@ -0,0 +1,400 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define NOMINMAX
+
+#include "spsa.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <windows.h>
+
+#include "checkpoint.h"
+#include "engine.h"
+#include "game.h"
+#include "metrics.h"
+#include "misc.h"
+#include "openings.h"
+#include "results.h"
+
+namespace {
+
+// Spall's gain sequences, with the usual alpha = 0.602, gamma = 0.101 and A = 10% of the
+// pairs, scaled so that the last pair perturbs by step and learns at rate
+void gains(const SpsaParam& p, int k, int total, double& c, double& r)
+{
+    double A = 0.1 * total;
+
+    c = p.step * std::pow(double(total) / k, 0.101);
+    r = p.rate * p.step * p.step * std::pow((A + total) / (A + k), 0.602) / (c * c);
+}
+
+std::string format(const char *fmt, double v)
+{
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), fmt, v);
+    return buffer;
+}
+
+std::string spec(const std::vector<SpsaParam>& params, int total)
+{
+    std::string s = "pairs " + std::to_string(total) + "\n";
+
+    for (const SpsaParam& p : params)
+        s += "param " + p.name + format(" %g", p.start) + format(" %g", p.min) + format(" %g", p.max)
+                               + format(" %g", p.step)  + format(" %g", p.rate) + "\n";
+
+    return s;
+}
+
+// UCI spin options take integers
+std::string setoptions(const std::vector<SpsaParam>& params, const std::vector<double>& values)
+{
+    std::string s;
+
+    for (size_t i = 0; i < params.size(); i++)
+        s += "setoption name " + params[i].name + " value " + std::to_string(std::llround(values[i])) + "\n";
+
+    return s;
+}
+
+// One thread playing pairs with its own two processes of the engine
+class SpsaSlot
+{
+public:
+    SpsaSlot(int id, const std::string& path, int time, const std::vector<SpsaParam>& params, const std::vector<std::string>& fens, Spsa& spsa)
+        : plus(path, time, id), minus(path, time, id), m_params(params), m_fens(fens), m_spsa(spsa), m_id(id)
+    {
+        plus.handshake();
+        minus.handshake();
+
+        log.open("logs\\"+plus.name()+"_spsa_"+std::to_string(time)+"_id"+std::to_string(m_id)+".txt");
+    }
+
+    void run(Control *control);
+
+    Engine plus;
+    Engine minus;
+
+private:
+    const std::vector<SpsaParam>&   m_params;
+    const std::vector<std::string>& m_fens;
+    Spsa&                           m_spsa;
+    int                             m_id;
+    std::ofstream                   log;
+};
+
+void SpsaSlot::run(Control *control)
+{
+    std::random_device rd;
+    std::mt19937_64    rng((uint64_t(rd()) << 32) | rd());
+    SpsaPair           pair;
+    bool               failed = false;
+
+    while (control->next_game(m_id) && m_spsa.next(pair, rng))
+    {
+        std::string options[2] = { setoptions(m_params, pair.plus), setoptions(m_params, pair.minus) };
+
+        plus.sync(options[0]);
+        minus.sync(options[1]);
+
+        // Both games of a pair start from the same opening, with colors reversed
+        const std::string& fen = m_fens[rng() % m_fens.size()];
+
+        int wins[2] = {};
+        int played  = 0;
+
+        for (; played < 2; played++)
+        {
+            Engine& white = played == 0 ? plus : minus;
+            Engine& black = played == 0 ? minus : plus;
+
+            GameResult r = play_game(white, black, fen, control, log);
+
+            if (r.error == ENGINE_ILLEGAL_MOVE || r.aborted())
+            {
+                failed = r.failed;
+                break;
+            }
+
+            log << "\n" << std::endl;
+
+            // A time forfeit or crash is a loss; the loser gets a fresh process, with its options, for the next game
+            if (r.failed)
+            {
+                Engine& loser = r.winner == WHITE ? black : white;
+
+                loser.restart();
+                loser.sync(options[&loser == &plus ? 0 : 1]);
+            }
+
+            if (r.decisive())
+                wins[(r.winner == WHITE) == (played == 0) ? 0 : 1]++;
+        }
+
+        // An unfinished pair says nothing about delta, it is left for the next run
+        if (played < 2)
+            break;
+
+        int finished = m_spsa.update(pair, wins[0], wins[1]);
+
+        metrics().set_progress(2 * finished, 2 * m_spsa.total);
+
+        std::string theta;
+
+        for (const SpsaParam& p : m_spsa.params())
+            theta += " " + p.name + format("=%.2f", p.value);
+
+        printf("%s Slot %d Pair %d/%d +%d =%d -%d%s\n", time_().c_str(), m_id, finished, m_spsa.total, wins[0], 2 - wins[0] - wins[1], wins[1], theta.c_str());
+    }
+
+    plus.kill();
+    minus.kill();
+
+    std::cout << "Slot " << m_id << (failed ? ": Engine error" : ": Done") << std::endl;
+}
+
+void print_params(Spsa& spsa)
+{
+    printf("\nPair %d/%d, plus +%d =%d -%d\n", spsa.finished, spsa.total, spsa.plus_wins, spsa.draws, spsa.minus_wins);
+
+    for (const SpsaParam& p : spsa.params())
+        printf("%-24s %12.3f  (start %g, range %g..%g)\n", p.name.c_str(), p.value, p.start, p.min, p.max);
+
+    printf("\n");
+}
+
+}
+
+Spsa::Spsa(const std::vector<SpsaParam>& params, int pairs)
+    : plus_wins(0), minus_wins(0), draws(0), finished(0), total(pairs), m_params(params), started(0)
+{
+    for (SpsaParam& p : m_params)
+        p.value = p.start;
+}
+
+bool Spsa::next(SpsaPair& pair, std::mt19937_64& rng)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+
+    if (started >= total)
+        return false;
+
+    pair.k = ++started;
+    pair.delta.clear();
+    pair.plus.clear();
+    pair.minus.clear();
+
+    for (const SpsaParam& p : m_params)
+    {
+        double c, r;
+        gains(p, pair.k, total, c, r);
+
+        int delta = rng() & 1 ? 1 : -1;
+
+        pair.delta.push_back(delta);
+        pair.plus.push_back(std::clamp(p.value + c * delta, p.min, p.max));
+        pair.minus.push_back(std::clamp(p.value - c * delta, p.min, p.max));
+    }
+
+    return true;
+}
+
+int Spsa::update(const SpsaPair& pair, int plus_wins_, int minus_wins_)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+
+    for (size_t i = 0; i < m_params.size(); i++)
+    {
+        SpsaParam& p = m_params[i];
+        double c, r;
+
+        gains(p, pair.k, total, c, r);
+        p.value = std::clamp(p.value + r * c * (plus_wins_ - minus_wins_) * pair.delta[i], p.min, p.max);
+    }
+
+    plus_wins  += plus_wins_;
+    minus_wins += minus_wins_;
+    draws      += 2 - plus_wins_ - minus_wins_;
+
+    trajectory += "pair " + std::to_string(++finished) + " " + std::to_string(plus_wins) + " " + std::to_string(minus_wins) + " " + std::to_string(draws);
+
+    for (const SpsaParam& p : m_params)
+        trajectory += format(" %.4f", p.value);
+
+    trajectory += "\n";
+
+    return finished;
+}
+
+std::vector<SpsaParam> Spsa::params()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return m_params;
+}
+
+std::string Spsa::checkpoint(const std::string& header)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return header + spec(m_params, total) + trajectory + "end\n";
+}
+
+// Takes theta and the score from the last pair of a checkpoint written for the same header and parameters
+bool Spsa::resume(const std::string& header, const std::string& saved)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+
+    std::string expected = header + spec(m_params, total);
+
+    if (saved.compare(0, expected.size(), expected) != 0 || saved.size() < 4 || saved.compare(saved.size() - 4, 4, "end\n") != 0)
+        return false;
+
+    std::istringstream is(saved.substr(expected.size()));
+    std::string line, token;
+
+    while (std::getline(is, line) && line != "end")
+    {
+        std::istringstream ls(line);
+
+        if (!(ls >> token >> finished >> plus_wins >> minus_wins >> draws) || token != "pair")
+            return false;
+
+        for (SpsaParam& p : m_params)
+            if (!(ls >> p.value))
+                return false;
+
+        trajectory += line + "\n";
+    }
+
+    started = finished;
+
+    return true;
+}
+
+bool load_spsa_params(const std::string& path, std::vector<SpsaParam>& params)
+{
+    std::ifstream in(path);
+    std::string line;
+
+    if (!in)
+        return false;
+
+    while (std::getline(in, line))
+    {
+        std::replace(line.begin(), line.end(), ',', ' ');
+
+        std::istringstream is(line);
+        SpsaParam p;
+
+        if (!(is >> p.name) || p.name[0] == '#')
+            continue;
+
+        if (!(is >> p.start >> p.min >> p.max >> p.step >> p.rate) || p.min > p.start || p.start > p.max || p.step <= 0 || p.rate <= 0)
+        {
+            std::cout << "Bad SPSA parameter '" << line << "' in " << path << std::endl;
+            return false;
+        }
+
+        params.push_back(p);
+    }
+
+    return !params.empty();
+}
+
+bool run_spsa(const std::string& params_file, const std::string& engine, int games, int time, int threads, const std::string& fen_file,
+              const std::string& checkpoint, int checkpoint_interval, bool resume, Control *control)
+{
+    std::vector<SpsaParam> params;
+
+    if (!load_spsa_params(params_file, params))
+    {
+        std::cout << "No SPSA parameters found in " << params_file << std::endl;
+        return false;
+    }
+
+    std::vector<std::string> fens = load_openings(fen_file, std::thread::hardware_concurrency());
+
+    if (fens.empty())
+    {
+        std::cout << "No positions found in " << fen_file << std::endl;
+        return false;
+    }
+
+    Spsa spsa(params, (games + 1) / 2);
+
+    std::string header = "spsa 1\nengine " + engine + "\ntime " + std::to_string(time) + "\n";
+
+    if (resume)
+    {
+        std::ifstream in(checkpoint, std::ios::binary);
+        std::ostringstream saved;
+
+        saved << in.rdbuf();
+
+        if (!in || !spsa.resume(header, saved.str()))
+        {
+            std::cout << "Could not resume from " << checkpoint << ", it is missing or was written by a different run" << std::endl;
+            return false;
+        }
+
+        std::cout << "Resuming SPSA at pair " << spsa.finished << "/" << spsa.total << " from " << checkpoint << std::endl;
+    }
+
+    metrics().set_progress(2 * spsa.finished, 2 * spsa.total);
+
+    std::vector<SpsaSlot*> slots;
+    std::vector<std::thread> thread_pool;
+
+    for (int id = 0; id < threads; id++) {
+        slots.push_back(new SpsaSlot(id, engine, time, params, fens, spsa));
+        thread_pool.emplace_back(&SpsaSlot::run, slots.back(), control);
+    }
+
+    control->set_stats([&]() { print_params(spsa); });
+
+    auto save = [&]() {
+        if (!replace_file(checkpoint, spsa.checkpoint(header)))
+            std::cout << "Could not write checkpoint " << checkpoint << std::endl;
+    };
+
+    std::atomic<bool> done = false;
+
+    std::thread saver([&]() {
+        for (uint64_t last = unix_ms(); !done; Sleep(100))
+            if (unix_ms() - last >= checkpoint_interval * 1000ull) {
+                save();
+                last = unix_ms();
+            }
+    });
+
+    for (std::thread& thread : thread_pool)
+        thread.join();
+
+    control->set_stats(nullptr);
+
+    done = true;
+    saver.join();
+    save();
+
+    EngineSummary plus = { engine_name(engine) + "+", spsa.plus_wins, spsa.minus_wins, spsa.draws };
+    EngineSummary minus = { engine_name(engine) + "-", spsa.minus_wins, spsa.plus_wins, spsa.draws };
+
+    for (SpsaSlot *s : slots)
+    {
+        plus.times.merge(s->plus.times);
+        minus.times.merge(s->minus.times);
+        plus.search.merge(s->plus.search);
+        minus.search.merge(s->minus.search);
+        plus.usage.merge(s->plus.usage());
+        minus.usage.merge(s->minus.usage());
+        delete s;
+    }
+
+    print_params(spsa);
+    print_summary({ plus, minus });
+
+    return true;
+}
@@ -0,0 +1,70 @@
+
+#ifndef SPSA_H
+#define SPSA_H
+
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "control.h"
+
+// One tuned UCI spin option. step and rate are the perturbation and learning rate reached at
+// the end of the run; both are larger early on, as in the usual SPSA gain sequences
+struct SpsaParam
+{
+    std::string name;
+    double      start;
+    double      min;
+    double      max;
+    double      step;
+    double      rate;
+    double      value;
+};
+
+// One game pair: plus plays theta + c_k * delta against minus with theta - c_k * delta
+struct SpsaPair
+{
+    int                 k;
+    std::vector<int>    delta;
+    std::vector<double> plus;
+    std::vector<double> minus;
+};
+
+// Theta of a run, shared by all threads. A pair is played with theta as it was when the pair
+// started, and its result is applied to theta as it is when the pair ends, so no thread waits
+// for another's games
+class Spsa
+{
+public:
+    Spsa(const std::vector<SpsaParam>& params, int pairs);
+
+    bool next(SpsaPair& pair, std::mt19937_64& rng);  // false when all pairs are handed out
+    int  update(const SpsaPair& pair, int plus_wins, int minus_wins);  // of the pair, returns # of pairs finished
+
+    std::vector<SpsaParam> params();
+    std::string checkpoint(const std::string& header);
+    bool resume(const std::string& header, const std::string& saved);
+
+    int plus_wins;
+    int minus_wins;
+    int draws;
+    int finished;
+    int total;
+
+private:
+    std::mutex             mtx;
+    std::vector<SpsaParam> m_params;
+    std::string            trajectory;  // theta after every pair, as in the checkpoint
+    int                    started;
+};
+
+// Reads 'name start min max step rate' per line, commas or spaces between the fields
+bool load_spsa_params(const std::string& path, std::vector<SpsaParam>& params);
+
+// --spsa: tunes the options in params_file of engine by playing it against itself on threads
+// threads, games / 2 pairs in all. Theta and its trajectory are saved to checkpoint
+bool run_spsa(const std::string& params_file, const std::string& engine, int games, int time, int threads, const std::string& fen_file,
+              const std::string& checkpoint, int checkpoint_interval, bool resume, Control *control);
+
+#endif
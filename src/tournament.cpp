@@ -0,0 +1,421 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define NOMINMAX
+
+#include "tournament.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <thread>
+
+#include "metrics.h"
+#include "misc.h"
+#include "rating.h"
+#include "results.h"
+#include "stats.h"
+
+Scheduler::Scheduler(TournamentType type, int engines, int openings, int games) : standings (engines),
+                                                                                   finished  (0),
+                                                                                   total     (0),
+                                                                                   m_type    (type),
+                                                                                   m_openings(openings),
+                                                                                   m_games   (games + (games & 1))
+{
+    for (int a = 0; a < engines; a++)
+        for (int b = a + 1; b < engines; b++)
+            if (type != GAUNTLET || a == 0)
+                pairings.push_back({ a, b, 0, 0, 0, 0 });
+
+    // Swiss games are scheduled in pairs, so when engines * games / 2 is odd one engine ends a pair short
+    total = type == SWISS ? engines * m_games / 4 * 2 : pairings.size() * m_games;
+}
+
+int Scheduler::warmth(int pairing, const std::vector<int>& warm) const
+{
+    return std::count(warm.begin(), warm.end(), pairings[pairing].first)
+         + std::count(warm.begin(), warm.end(), pairings[pairing].second);
+}
+
+int Scheduler::pick_pairing(const std::vector<int>& warm)
+{
+    int best = -1;
+
+    if (m_type != SWISS)
+    {
+        for (int i = 0; i < pairings.size(); i++)
+        {
+            if (pairings[i].scheduled >= m_games)
+                continue;
+
+            if (   best == -1
+                || pairings[i].scheduled <  pairings[best].scheduled
+                || pairings[i].scheduled == pairings[best].scheduled && warmth(i, warm) > warmth(best, warm))
+                best = i;
+        }
+
+        return best;
+    }
+
+    // Swiss: the engine furthest behind on games gets the opponent closest to it
+    // in score, with a penalty for every previous meeting. Opponents that have all
+    // their games are never picked, so no engine plays more than --games
+
+    int e = -1;
+
+    for (int i = 0; i < standings.size(); i++)
+    {
+        if (standings[i].scheduled >= m_games)
+            continue;
+
+        bool warm_i = std::count(warm.begin(), warm.end(), i);
+        bool warm_e = e != -1 && std::count(warm.begin(), warm.end(), e);
+
+        if (e == -1 || standings[i].scheduled < standings[e].scheduled
+                    || standings[i].scheduled == standings[e].scheduled && warm_i && !warm_e)
+            e = i;
+    }
+
+    if (e == -1)
+        return -1;
+
+    double best_cost = 0;
+
+    for (int i = 0; i < pairings.size(); i++)
+    {
+        if (pairings[i].first != e && pairings[i].second != e)
+            continue;
+
+        int o = pairings[i].first == e ? pairings[i].second : pairings[i].first;
+
+        if (standings[o].scheduled >= m_games)
+            continue;
+
+        double cost = std::abs(standings[e].score() - standings[o].score())
+                    + 0.25 * pairings[i].scheduled / 2
+                    - 0.01 * warmth(i, warm);
+
+        if (best == -1 || cost < best_cost)
+        {
+            best = i;
+            best_cost = cost;
+        }
+    }
+
+    return best;
+}
+
+bool Scheduler::next_job(Job& job, const std::vector<int>& warm)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+
+    if (pending.empty())
+    {
+        int p = pick_pairing(warm);
+
+        if (p == -1)
+            return false;
+
+        int round   = pairings[p].scheduled / 2;
+        int opening = round % m_openings;
+
+        pairings[p].scheduled += 2;
+        standings[pairings[p].first].scheduled += 2;
+        standings[pairings[p].second].scheduled += 2;
+
+        pending.push_back({ p, opening, WHITE, round });
+        pending.push_back({ p, opening, BLACK, round });
+    }
+
+    auto it = std::max_element(pending.begin(), pending.end(), [&](const Job& a, const Job& b) {
+        return warmth(a.pairing, warm) < warmth(b.pairing, warm);
+    });
+
+    job = *it;
+    pending.erase(it);
+
+    return true;
+}
+
+int Scheduler::report(const Job& job, const GameResult& r)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+
+    Pairing&  p      = pairings[job.pairing];
+    Standing& first  = standings[p.first];
+    Standing& second = standings[p.second];
+
+    if (!r.decisive())
+    {
+        p.draws++;
+        first.draws++;
+        second.draws++;
+    }
+    else if (r.winner == job.first_color)
+    {
+        p.first_wins++;
+        first.wins++;
+        second.losses++;
+    }
+    else
+    {
+        p.second_wins++;
+        second.wins++;
+        first.losses++;
+    }
+
+    return ++finished;
+}
+
+void Scheduler::snapshot(std::vector<Standing>& s, std::vector<Pairing>& p)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+
+    s = standings;
+    p = pairings;
+}
+
+void print_standings(const std::vector<std::string>& paths, const std::vector<Standing>& standings, const std::vector<Pairing>& pairings, const Ratings& r)
+{
+    std::vector<int> order(paths.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return r.elo[a] > r.elo[b]; });
+
+    printf(R"(
++------------------+-------+-------+-------+--------+---------+-----------------+
+| Engine           | Games |  Wins | Draws | Losses |  Score  |       Elo       |
++------------------+-------+-------+-------+--------+---------+-----------------+
+)");
+
+    for (int i : order)
+    {
+        const Standing& s = standings[i];
+
+        printf("| %-17s|%6d |%6d |%6d |%7d |%7.2f%% |%+7.1f +/-%5.1f |\n",
+               engine_name(paths[i]).c_str(), s.games(), s.wins, s.draws, s.losses, s.score() * 100, r.elo[i], r.margin[i]);
+    }
+
+    printf("+------------------+-------+-------+-------+--------+---------+-----------------+\n");
+    printf("Davidson draw parameter %.3f, %d iterations\n\n", r.draw_nu, r.iterations);
+
+    for (const Pairing& p : pairings)
+    {
+        if (p.first_wins + p.second_wins + p.draws == 0)
+            continue;
+
+        printf("%s vs %s: +%d =%d -%d (%+.1f +/- %.1f)\n",
+               engine_name(paths[p.first]).c_str(), engine_name(paths[p.second]).c_str(),
+               p.first_wins, p.draws, p.second_wins,
+               elo_diff(p.first_wins, p.second_wins, p.draws), elo_margin(p.first_wins, p.second_wins, p.draws));
+    }
+}
+
+Slot::Slot(int id, const std::vector<std::string>& paths, int time, int cache_size, int rating_interval, Scheduler& scheduler, const std::vector<std::string>& fens, OpeningHistory& history, std::string datagen, uint64_t rotate)
+    : times(paths.size()), search(paths.size()), usage(paths.size()), m_paths(paths), m_fens(fens), m_scheduler(scheduler), m_history(history), m_id(id), m_time(time), m_cache_size(cache_size), m_rating_interval(rating_interval)
+{
+    log.open("logs\\tournament_"+std::to_string(time)+"_id"+std::to_string(m_id)+".txt");
+
+    if (!datagen.empty())
+        data = std::make_unique<DataWriter>(datagen+"\\tournament_id"+std::to_string(m_id), rotate);
+}
+
+Engine& Slot::engine(int idx)
+{
+    for (size_t i = 0; i < cache.size(); i++)
+        if (cache[i].first == idx)
+        {
+            std::rotate(cache.begin() + i, cache.begin() + i + 1, cache.end());
+            return *cache.back().second;
+        }
+
+    if (cache.size() >= m_cache_size)
+        retire(0);
+
+    cache.emplace_back(idx, std::make_unique<Engine>(m_paths[idx], m_time, m_id));
+    cache.back().second->handshake();
+
+    return *cache.back().second;
+}
+
+void Slot::retire(size_t i)
+{
+    cache[i].second->kill();
+    usage[cache[i].first].merge(cache[i].second->usage());
+    cache.erase(cache.begin() + i);
+}
+
+void Slot::evict(int idx)
+{
+    for (size_t i = 0; i < cache.size(); i++)
+        if (cache[i].first == idx)
+            retire(i--);
+}
+
+void Slot::run(Control *control)
+{
+    Job job;
+    std::vector<int> warm;
+
+    while (control->next_game(m_id))
+    {
+        warm.clear();
+        for (const auto& c : cache)
+            warm.push_back(c.first);
+
+        if (!m_scheduler.next_job(job, warm))
+            break;
+
+        int first  = m_scheduler.pairings[job.pairing].first;
+        int second = m_scheduler.pairings[job.pairing].second;
+        int w      = job.first_color == WHITE ? first : second;
+        int b      = job.first_color == WHITE ? second : first;
+
+        Engine& white = engine(w);
+        Engine& black = engine(b);
+
+        std::string id = std::to_string(job.pairing) + " " + std::to_string(job.round) + " " + std::to_string(job.first_color);
+
+        white.set_game(id);
+        black.set_game(id);
+
+        GameResult r = play_game(white, black, m_fens[job.opening], control, log, data.get());
+
+        if (r.aborted())
+            break;
+
+        log << "\n" << std::endl;
+
+        int finished = m_scheduler.report(job, r);
+
+        record_metrics(white, black, r);
+        metrics().set_progress(finished, m_scheduler.total);
+
+        if (!r.failed)
+            m_history.record(m_fens[job.opening], opening_outcome(r));
+
+        printf (
+            "%s Slot %d Game %d/%d %s vs %s %s (%s)\n",
+            time_().c_str(),
+            m_id,
+            finished,
+            m_scheduler.total,
+            white.name().c_str(),
+            black.name().c_str(),
+            !r.decisive() ? "1/2-1/2" : r.winner == WHITE ? "1-0" : "0-1",
+            termination_name(r)
+        );
+
+        times[w].merge(white.times);
+        times[b].merge(black.times);
+        search[w].merge(white.search);
+        search[b].merge(black.search);
+        white.times.clear();
+        black.times.clear();
+        white.search.clear();
+        black.search.clear();
+
+        if (r.failed)
+            evict(r.winner == WHITE ? b : w);
+
+        if (m_rating_interval && finished % m_rating_interval == 0)
+        {
+            std::vector<Standing> standings;
+            std::vector<Pairing>  pairings;
+
+            m_scheduler.snapshot(standings, pairings);
+            print_standings(m_paths, standings, pairings, compute_ratings(m_paths.size(), pairings, 200));
+        }
+    }
+
+    if (data)
+        data->flush();
+
+    while (!cache.empty())
+        retire(0);
+
+    std::cout << "Slot " << m_id << ": Done" << std::endl;
+}
+
+void run_tournament(const std::vector<std::string>& paths, TournamentType type, int games, int time, int threads, int cache_size, int rating_interval, const std::string& fen_file, Control *control, OpeningHistory *history, std::string results, std::string datagen, uint64_t rotate)
+{
+    std::vector<std::string> fens = load_openings(fen_file, std::thread::hardware_concurrency());
+
+    if (fens.empty())
+    {
+        std::cout << "No positions found in " << fen_file << std::endl;
+        std::exit(1);
+    }
+
+    std::random_device rd;
+    std::mt19937 g(rd());
+    std::shuffle(fens.begin(), fens.end(), g);
+
+    // Every pairing plays the openings in this order, so put those with the longest games so far first
+    std::vector<double> plies(fens.size());
+    for (size_t i = 0; i < fens.size(); i++)
+        plies[i] = history->expected_plies(fens[i]);
+
+    std::vector<int> order(fens.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return plies[a] > plies[b]; });
+
+    std::vector<std::string> sorted;
+    for (int i : order)
+        sorted.push_back(fens[i]);
+
+    fens.swap(sorted);
+
+    Scheduler scheduler(type, paths.size(), fens.size(), games ? games : 2 * fens.size());
+
+    metrics().set_progress(0, scheduler.total);
+
+    std::vector<Slot*> slots;
+    std::vector<std::thread> thread_pool;
+
+    for (int id = 0; id < threads; id++) {
+        slots.push_back(new Slot(id, paths, time, cache_size, rating_interval, scheduler, fens, *history, datagen, rotate));
+        thread_pool.emplace_back(&Slot::run, slots.back(), control);
+    }
+
+    control->set_stats([&]() {
+        std::vector<Standing> standings;
+        std::vector<Pairing>  pairings;
+
+        scheduler.snapshot(standings, pairings);
+        print_standings(paths, standings, pairings, compute_ratings(paths.size(), pairings, 200));
+    });
+
+    for (std::thread& thread : thread_pool)
+        thread.join();
+
+    control->set_stats(nullptr);
+
+    std::vector<EngineSummary> summaries;
+
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        const Standing& s = scheduler.standings[i];
+        summaries.push_back({ engine_name(paths[i]), s.wins, s.losses, s.draws });
+    }
+
+    for (Slot *s : slots)
+    {
+        for (size_t i = 0; i < paths.size(); i++)
+        {
+            summaries[i].times.merge(s->times[i]);
+            summaries[i].search.merge(s->search[i]);
+            summaries[i].usage.merge(s->usage[i]);
+        }
+
+        delete s;
+    }
+
+    print_standings(paths, scheduler.standings, scheduler.pairings,
+                    compute_ratings(paths.size(), scheduler.pairings, 1000, std::max(1u, std::thread::hardware_concurrency())));
+
+    print_summary(summaries);
+
+    if (!results.empty() && !write_results(results, summaries))
+        std::cout << "Could not write " << results << std::endl;
+}
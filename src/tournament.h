@@ -0,0 +1,109 @@
+
+#ifndef TOURNAMENT_H
+#define TOURNAMENT_H
+
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "datagen.h"
+#include "engine.h"
+#include "game.h"
+#include "openings.h"
+
+enum TournamentType { ROUND_ROBIN, GAUNTLET, SWISS };
+
+struct Job
+{
+    int   pairing;
+    int   opening;
+    Color first_color;
+    int   round;  // of the pairing, every round is one opening played with both colors
+};
+
+struct Pairing
+{
+    int first;
+    int second;
+    int scheduled;
+    int first_wins;
+    int second_wins;
+    int draws;
+};
+
+struct Standing
+{
+    int wins;
+    int losses;
+    int draws;
+    int scheduled;
+
+    int games() const { return wins + losses + draws; }
+    double score() const { return games() ? (wins + 0.5 * draws) / games() : 0.5; }
+};
+
+// Hands out (pairing, opening, color) jobs to the slots. Every opening is played twice
+// by a pairing with colors reversed, and pairings are picked so that game counts stay
+// balanced, preferring engines that the asking slot already has running.
+class Scheduler
+{
+public:
+    Scheduler(TournamentType type, int engines, int openings, int games);
+
+    bool next_job(Job& job, const std::vector<int>& warm);
+    int  report(const Job& job, const GameResult& r);
+    void snapshot(std::vector<Standing>& s, std::vector<Pairing>& p);
+
+    std::vector<Pairing>  pairings;
+    std::vector<Standing> standings;
+
+    int finished;
+    int total;
+
+private:
+    int pick_pairing(const std::vector<int>& warm);
+    int warmth(int pairing, const std::vector<int>& warm) const;
+
+    std::mutex      mtx;
+    std::deque<Job> pending;
+    TournamentType  m_type;
+    int             m_openings;
+    int             m_games;
+};
+
+class Slot
+{
+public:
+    Slot(int id, const std::vector<std::string>& paths, int time, int cache_size, int rating_interval, Scheduler& scheduler, const std::vector<std::string>& fens, OpeningHistory& history, std::string datagen = "", uint64_t rotate = 0);
+
+    void run(Control *control);
+
+    std::vector<MoveTimes>     times;
+    std::vector<SearchStats>   search;
+    std::vector<ResourceUsage> usage;
+
+private:
+    Engine& engine(int idx);
+    void evict(int idx);
+    void retire(size_t i);
+
+    std::vector<std::pair<int, std::unique_ptr<Engine>>> cache;
+
+    const std::vector<std::string>& m_paths;
+    const std::vector<std::string>& m_fens;
+    Scheduler&                      m_scheduler;
+    OpeningHistory&                 m_history;
+    std::unique_ptr<DataWriter>     data;
+    std::ofstream                   log;
+    int                             m_id;
+    int                             m_time;
+    int                             m_cache_size;
+    int                             m_rating_interval;
+};
+
+void run_tournament(const std::vector<std::string>& paths, TournamentType type, int games, int time, int threads, int cache_size, int rating_interval, const std::string& fen_file, Control *control, OpeningHistory *history, std::string results = "", std::string datagen = "", uint64_t rotate = 0);
+
+#endif
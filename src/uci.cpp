@@ -1,82 +1,164 @@
-
-#include "uci.h"
-
-#include <algorithm>
-#include <sstream>
-
-Move uci_to_move(const std::string& uci, const Position& pos)
-{
-    for (Move list[MAX_MOVES], *m = list, *end = pos.get_moves(list); m != end; m++)
-        if (move_to_uci(*m) == uci) return *m;
-
-    return Move::null();
-}
-
-std::string move_to_san(Move m, Position pos)
-{
-    char pt2c[] = "  PNBRQK";
-    char f2c [] = "hgfedcba";
-    char r2c [] = "12345678";
-
-    Square    from    = m.from_sq();
-    Square    to      = m.to_sq();
-    Piece     pc      = pos.piece_on(from);
-    PieceType pt      = type_of(pc);
-    bool      capture = pos.piece_on(to) || m.type_of() == ENPASSANT;
-    
-    std::stringstream san;
-
-    if (m.type_of() == CASTLING)
-    {
-        san << (file_of(to) == FILE_G_ENUM ? "O-O" : "O-O-O");
-    }
-    else if (pt == PAWN)
-    {
-        if (capture)
-            san << f2c[file_of(from)] << "x";
-
-        san << square_to_uci(to);
-
-        if (m.type_of() == PROMOTION)
-            san << "=" << pt2c[m.promotion_type()];
-    }
-    else
-    {
-        int i;
-        std::vector<std::string> notations[4];
-
-        for (Move list[MAX_MOVES], *mp = list, *end = pos.get_moves(list); mp != end; mp++)
-        {
-            if (*mp == m) i = mp - list;
-
-            Square f = mp->from_sq();
-            Square t = mp->to_sq();
-
-            std::string left = std::string(1, pt2c[type_of(pos.piece_on(f))]);
-            std::string right = pos.piece_on(t)
-                ? std::string("x") + square_to_uci(t)
-                : square_to_uci(t);
-
-            char file = f2c[file_of(f)];
-            char rank = r2c[rank_of(f)];
-
-            notations[0].push_back(left + right);
-            notations[1].push_back(left + file + right);
-            notations[2].push_back(left + rank + right);
-            notations[3].push_back(left + file + rank + right);
-        }
-
-        for (const std::vector<std::string>& v : notations)
-            if (std::count(v.begin(), v.end(), v[i]) == 1) { san << v[i]; break; }
-    }
-    
-    pos.do_move(m);
-
-    if (pos.game_state() == MATE) {
-        san << '#';
-    } else if (pos.checkers()) {
-        san << '+';
-    }
-
-    return san.str();
+
+#include "uci.h"
+
+#include <algorithm>
+#include <sstream>
+
+// Compares squares instead of formatting every legal move, this runs for every move of
+// every game played or verified
+Move uci_to_move(std::string_view uci, const Position& pos)
+{
+    if (uci.size() != 4 && uci.size() != 5)
+        return Move::null();
+
+    for (int i : { 0, 2 })
+        if (uci[i] < 'a' || uci[i] > 'h' || uci[i + 1] < '1' || uci[i + 1] > '8')
+            return Move::null();
+
+    Square from = uci_to_square(uci), to = uci_to_square(uci.substr(2));
+
+    for (Move list[MAX_MOVES], *m = list, *end = pos.get_moves(list); m != end; m++)
+        if (m->from_sq() == from && m->to_sq() == to)
+        {
+            if (m->type_of() != PROMOTION ? uci.size() == 4 : uci.size() == 5 && uci[4] == "   nbrq"[m->promotion_type()])
+                return *m;
+        }
+
+    return Move::null();
+}
+
+// Accepts what move_to_san writes and the usual variants in PGN files: check and annotation
+// suffixes, '0-0' castling, promotions with or without '=', and redundant disambiguation
+Move san_to_move(std::string_view san, const Position& pos)
+{
+    while (!san.empty() && std::string_view("+#!?").find(san.back()) != std::string_view::npos)
+        san.remove_suffix(1);
+
+    Move list[MAX_MOVES], *end = pos.get_moves(list), found = Move::null();
+
+    if (san == "O-O" || san == "0-0" || san == "O-O-O" || san == "0-0-0")
+    {
+        for (Move *m = list; m != end; m++)
+            if (m->type_of() == CASTLING && (file_of(m->to_sq()) == FILE_G_ENUM) == (san.size() == 3))
+                return *m;
+
+        return Move::null();
+    }
+
+    PieceType pt = PAWN, promotion = 0;
+
+    if (!san.empty() && std::string_view("NBRQK").find(san[0]) != std::string_view::npos)
+    {
+        pt = std::string_view("  PNBRQK").find(san[0]);
+        san.remove_prefix(1);
+    }
+
+    if (pt == PAWN && !san.empty() && std::string_view("NBRQ").find(san.back()) != std::string_view::npos)
+    {
+        promotion = std::string_view("  PNBRQK").find(san.back());
+        san.remove_suffix(san.size() > 1 && san[san.size() - 2] == '=' ? 2 : 1);
+    }
+
+    if (san.size() < 2 || san[san.size() - 2] < 'a' || san[san.size() - 2] > 'h' || san.back() < '1' || san.back() > '8')
+        return Move::null();
+
+    Square to   = uci_to_square(san.substr(san.size() - 2));
+    int    file = -1, rank = -1;
+
+    for (char c : san.substr(0, san.size() - 2))
+        if (c >= 'a' && c <= 'h')
+            file = 'h' - c;
+        else if (c >= '1' && c <= '8')
+            rank = c - '1';
+        else if (c != 'x')
+            return Move::null();
+
+    for (Move *m = list; m != end; m++)
+    {
+        Square from = m->from_sq();
+
+        if (   m->to_sq() != to
+            || m->type_of() == CASTLING
+            || type_of(pos.piece_on(from)) != pt
+            || (file >= 0 && file_of(from) != file)
+            || (rank >= 0 && rank_of(from) != rank)
+            || (m->type_of() == PROMOTION ? m->promotion_type() != promotion : promotion != 0))
+            continue;
+
+        if (found != Move::null())
+            return Move::null();
+
+        found = *m;
+    }
+
+    return found;
+}
+
+std::string move_to_san(Move m, Position pos)
+{
+    char pt2c[] = "  PNBRQK";
+    char f2c [] = "hgfedcba";
+    char r2c [] = "12345678";
+
+    Square    from    = m.from_sq();
+    Square    to      = m.to_sq();
+    Piece     pc      = pos.piece_on(from);
+    PieceType pt      = type_of(pc);
+    bool      capture = pos.piece_on(to) || m.type_of() == ENPASSANT;
+    
+    std::stringstream san;
+
+    if (m.type_of() == CASTLING)
+    {
+        san << (file_of(to) == FILE_G_ENUM ? "O-O" : "O-O-O");
+    }
+    else if (pt == PAWN)
+    {
+        if (capture)
+            san << f2c[file_of(from)] << "x";
+
+        san << square_to_uci(to);
+
+        if (m.type_of() == PROMOTION)
+            san << "=" << pt2c[m.promotion_type()];
+    }
+    else
+    {
+        int i;
+        std::vector<std::string> notations[4];
+
+        for (Move list[MAX_MOVES], *mp = list, *end = pos.get_moves(list); mp != end; mp++)
+        {
+            if (*mp == m) i = mp - list;
+
+            Square f = mp->from_sq();
+            Square t = mp->to_sq();
+
+            std::string left = std::string(1, pt2c[type_of(pos.piece_on(f))]);
+            std::string right = pos.piece_on(t)
+                ? std::string("x") + square_to_uci(t)
+                : square_to_uci(t);
+
+            char file = f2c[file_of(f)];
+            char rank = r2c[rank_of(f)];
+
+            notations[0].push_back(left + right);
+            notations[1].push_back(left + file + right);
+            notations[2].push_back(left + rank + right);
+            notations[3].push_back(left + file + rank + right);
+        }
+
+        for (const std::vector<std::string>& v : notations)
+            if (std::count(v.begin(), v.end(), v[i]) == 1) { san << v[i]; break; }
+    }
+    
+    pos.do_move(m);
+
+    if (pos.game_state() == MATE) {
+        san << '#';
+    } else if (pos.checkers()) {
+        san << '+';
+    }
+
+    return san.str();
 }
\ No newline at end of file
@@ -0,0 +1,700 @@
+
+#include "verify.h"
+
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string_view>
+#include <thread>
+
+#include "bitboard.h"
+#include "datagen.h"
+#include "game.h"
+#include "uci.h"
+
+namespace {
+
+enum Format { LOG_FILE, PGN_FILE, DATA_FILE };
+
+struct Archive
+{
+    std::string path;
+    Format      format;
+    uint64_t    size;
+};
+
+// A byte range of an archive. It owns the games whose first line or record starts in it
+struct Chunk
+{
+    int      archive;
+    uint64_t begin;
+    uint64_t end;
+};
+
+constexpr uint64_t ChunkSize   = 1 << 22;
+constexpr uint64_t MaxReported = 1000;
+
+struct Totals
+{
+    std::atomic<uint64_t> games      = 0;
+    std::atomic<uint64_t> moves      = 0;
+    std::atomic<uint64_t> bytes      = 0;
+    std::atomic<uint64_t> unfinished = 0;
+    std::atomic<uint64_t> mismatches = 0;
+};
+
+std::mutex output_mtx;
+
+struct Context
+{
+    const Archive& archive;
+    Totals&        totals;
+    uint64_t       offset;  // of the game being checked
+
+    void mismatch(const std::string& what)
+    {
+        if (++totals.mismatches > MaxReported)
+            return;
+
+        std::lock_guard<std::mutex> lock(output_mtx);
+        std::cout << archive.path << " @" << offset << ": " << what << "\n";
+    }
+};
+
+// One deque of chunks per thread. Threads take from the back of their own deque and, once
+// it is empty, steal from the front of the others, so no thread idles while work is left
+class ChunkQueues
+{
+public:
+    explicit ChunkQueues(int threads) : queues(threads), locks(threads) {}
+
+    void push(int id, const Chunk& c) { queues[id].push_back(c); }
+
+    bool next(int id, Chunk& c)
+    {
+        for (int i = 0; i < queues.size(); i++)
+        {
+            int victim = (id + i) % queues.size();
+
+            std::lock_guard<std::mutex> lock(locks[victim]);
+
+            if (queues[victim].empty())
+                continue;
+
+            if (victim == id)
+            {
+                c = queues[id].back();
+                queues[id].pop_back();
+            }
+            else
+            {
+                c = queues[victim].front();
+                queues[victim].pop_front();
+            }
+
+            return true;
+        }
+
+        return false;
+    }
+
+private:
+    std::vector<std::deque<Chunk>> queues;
+    std::vector<std::mutex>        locks;
+};
+
+constexpr std::string_view Terminations[] = { "Checkmate", "Stalemate", "Repetition", "Fifty-move rule",
+                                              "Time forfeit", "Engine crash", "Illegal move", "Engine error", "Not recorded" };
+
+bool is_result(std::string_view token) {
+    return token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*";
+}
+
+std::string_view next_line(std::string_view& text)
+{
+    size_t n = text.find('\n');
+    std::string_view line = text.substr(0, n);
+
+    text.remove_prefix(n == std::string_view::npos ? text.size() : n + 1);
+
+    if (!line.empty() && line.back() == '\r')
+        line.remove_suffix(1);
+
+    return line;
+}
+
+std::string_view next_token(std::string_view& text)
+{
+    size_t begin = std::min(text.size(), text.find_first_not_of(" \t\r\n"));
+    size_t end   = std::min(text.size(), text.find_first_of(" \t\r\n", begin));
+
+    std::string_view token = text.substr(begin, end - begin);
+    text.remove_prefix(end);
+
+    return token;
+}
+
+// The next move or result of PGN movetext, skipping move numbers, comments, NAGs and variations
+std::string_view next_san(std::string_view& text)
+{
+    while (true)
+    {
+        text.remove_prefix(std::min(text.size(), text.find_first_not_of(" \t\r\n")));
+
+        if (text.empty())
+            return text;
+
+        if (text[0] == '{' || text[0] == ';')
+        {
+            size_t end = text.find(text[0] == '{' ? '}' : '\n');
+            text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+            continue;
+        }
+
+        if (text[0] == '(')
+        {
+            size_t end = 0;
+
+            for (int depth = 0; end < text.size(); end++)
+                if (text[end] == '(')
+                    depth++;
+                else if (text[end] == ')' && --depth == 0)
+                    break;
+
+            text.remove_prefix(std::min(text.size(), end + 1));
+            continue;
+        }
+
+        size_t end = std::min(text.size(), text.find_first_of(" \t\r\n{(;"));
+
+        std::string_view token = text.substr(0, end);
+        text.remove_prefix(end);
+
+        if (token[0] == '$')
+            continue;
+
+        // "12." and "12..." alone, or glued to the move as in "12.e4"
+        if (size_t digits = token.find_first_not_of("0123456789"); digits && digits != std::string_view::npos && token[digits] == '.')
+        {
+            if (size_t move = token.find_first_not_of("0123456789."); move != std::string_view::npos)
+                return token.substr(move);
+
+            continue;
+        }
+
+        return token;
+    }
+}
+
+std::string ply_info(int ply, const Position& pos) {
+    return " at ply " + std::to_string(ply) + " (" + pos.fen() + ")";
+}
+
+// Result and termination a game must have when the moves end in 'state'
+std::string expected_result(GameState state, const Position& pos)
+{
+    return state == MATE || state == ONGOING ? (pos.white_to_move() ? "0-1" : "1-0") : "1/2-1/2";
+}
+
+std::string expected_termination(GameState state, const Position& pos)
+{
+    GameResult r = { state, false, !pos.side_to_move(), 0, ENGINE_OK };
+    return termination_name(r);
+}
+
+// The line "position fen <fen> moves <moves>", the PGN tags and movetext, then either the
+// termination or the final board followed by "<engine>: <move> <- <termination>"
+void verify_log_game(Context& ctx, std::string_view text)
+{
+    std::string_view moves = next_line(text).substr(13);
+    size_t           split = moves.find(" moves");
+
+    if (split == std::string_view::npos)
+    {
+        ctx.mismatch("no move list");
+        return;
+    }
+
+    std::string fen(moves.substr(0, split));
+    moves.remove_prefix(split + 6);
+
+    std::string_view movetext, termination;
+
+    while (!text.empty() && termination.empty())
+    {
+        std::string_view line = next_line(text);
+
+        if (line.empty() || line[0] == '[')
+            continue;
+
+        if (movetext.empty())
+        {
+            movetext = line;
+            continue;
+        }
+
+        if (size_t arrow = line.find(" <- "); arrow != std::string_view::npos)
+            line.remove_prefix(arrow + 4);
+
+        for (std::string_view name : Terminations)
+            if (line.substr(0, name.size()) == name)
+                termination = name;
+    }
+
+    Position  pos;
+    GameState state    = ONGOING;
+    int       ply      = 0;
+    bool      finished = !movetext.empty();  // an aborted game has only the move list
+
+    if (const char *error = pos.set(fen) ? pos.validate() : "not a FEN")
+    {
+        ctx.mismatch("starting position " + fen + ": " + error);
+        return;
+    }
+
+    for (std::string_view uci; !(uci = next_token(moves)).empty(); ply++)
+    {
+        if (state != ONGOING)
+        {
+            ctx.mismatch("moves after " + expected_termination(state, pos) + ply_info(ply, pos));
+            return;
+        }
+
+        Move m = uci_to_move(uci, pos);
+
+        if (m == Move::null())
+        {
+            ctx.mismatch("illegal move " + std::string(uci) + ply_info(ply, pos));
+            return;
+        }
+
+        if (finished)
+            if (std::string_view san = next_san(movetext); san_to_move(san, pos) != m)
+            {
+                ctx.mismatch("PGN has " + std::string(san) + " instead of " + std::string(uci) + ply_info(ply, pos));
+                return;
+            }
+
+        pos.do_move(m);
+        state = pos.game_state();
+    }
+
+    ctx.totals.games++;
+    ctx.totals.moves += ply;
+
+    if (!finished)
+    {
+        ctx.totals.unfinished++;
+        return;
+    }
+
+    std::string result(next_san(movetext));
+
+    if (!is_result(result))
+        ctx.mismatch("PGN continues with " + result + " after the last move" + ply_info(ply, pos));
+
+    // A --replay game that left the recordings has no result
+    else if (result == "*" && termination == "Not recorded" && state == ONGOING)
+        ctx.totals.unfinished++;
+
+    else if (result != expected_result(state, pos))
+        ctx.mismatch("result " + result + ", expected " + expected_result(state, pos) + ply_info(ply, pos));
+
+    else if (state != ONGOING && termination != expected_termination(state, pos))
+        ctx.mismatch("termination '" + std::string(termination) + "', expected " + expected_termination(state, pos) + ply_info(ply, pos));
+
+    // Only a forfeit ends a game that is still going on
+    else if (state == ONGOING && (termination.empty() || termination == "Checkmate" || termination == "Stalemate"
+                                                      || termination == "Repetition" || termination == "Fifty-move rule"))
+        ctx.mismatch("termination '" + std::string(termination) + "' but the game is not over" + ply_info(ply, pos));
+}
+
+void verify_pgn_game(Context& ctx, std::string_view text)
+{
+    std::string      fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+    std::string_view result_tag;
+
+    for (std::string_view rest = text, line; !rest.empty(); text = rest)
+    {
+        line = next_line(rest);
+
+        if (line.find_first_not_of(" \t") == std::string_view::npos)
+            continue;
+
+        if (line[0] != '[')
+            break;
+
+        size_t quote = line.find('"'), last = line.rfind('"');
+        std::string_view name  = line.substr(1, line.find(' ') - 1);
+        std::string_view value = quote < last ? line.substr(quote + 1, last - quote - 1) : std::string_view();
+
+        if (name == "FEN")
+            fen = value;
+        else if (name == "Result")
+            result_tag = value;
+    }
+
+    Position         pos;
+    GameState        state = ONGOING;
+    int              ply   = 0;
+    std::string_view result;
+
+    if (const char *error = pos.set(fen) ? pos.validate() : "not a FEN")
+    {
+        ctx.mismatch("starting position " + fen + ": " + error);
+        return;
+    }
+
+    for (std::string_view san; !(san = next_san(text)).empty(); ply++)
+    {
+        if (is_result(san))
+        {
+            result = san;
+            break;
+        }
+
+        if (state != ONGOING)
+        {
+            ctx.mismatch("moves after " + expected_termination(state, pos) + ply_info(ply, pos));
+            return;
+        }
+
+        Move m = san_to_move(san, pos);
+
+        if (m == Move::null())
+        {
+            ctx.mismatch("illegal or ambiguous move " + std::string(san) + ply_info(ply, pos));
+            return;
+        }
+
+        pos.do_move(m);
+        state = pos.game_state();
+    }
+
+    ctx.totals.games++;
+    ctx.totals.moves += ply;
+
+    if (result.empty())
+        ctx.mismatch("movetext has no result" + ply_info(ply, pos));
+
+    else if (!result_tag.empty() && result != result_tag)
+        ctx.mismatch("Result tag " + std::string(result_tag) + ", movetext ends with " + std::string(result));
+
+    else if (result == "*")
+        ctx.totals.unfinished++;
+
+    else if (state != ONGOING && result != expected_result(state, pos))
+        ctx.mismatch("result " + std::string(result) + ", expected " + expected_result(state, pos) + ply_info(ply, pos));
+}
+
+bool same_position(const PackedPos& a, const PackedPos& b)
+{
+    return a.occupied       == b.occupied
+        && a.stm_castling   == b.stm_castling
+        && a.ep_sq          == b.ep_sq
+        && a.halfmove_clock == b.halfmove_clock
+        && !memcmp(a.pieces, b.pieces, sizeof(a.pieces));
+}
+
+// Consecutive records of one game, starting at ply 0. Every record must follow from the one
+// before by a legal move, and the game result must be reachable by one more move from the last
+void verify_data_game(Context& ctx, std::string_view bytes)
+{
+    std::vector<PackedPos> records(bytes.size() / sizeof(PackedPos));
+    memcpy(records.data(), bytes.data(), records.size() * sizeof(PackedPos));
+
+    Position pos;
+    pos.set(unpack(records[0]));
+
+    ctx.totals.games++;
+    ctx.totals.moves += records.size();
+
+    if (!same_position(pack(pos, 0, 0), records[0]))
+    {
+        ctx.mismatch("first record is not a valid position: " + unpack(records[0]));
+        return;
+    }
+
+    for (size_t i = 1; i < records.size(); i++)
+    {
+        const PackedPos& r = records[i];
+
+        if (r.ply != i || r.result != records[0].result)
+        {
+            ctx.mismatch("record " + std::to_string(i) + " has ply " + std::to_string(r.ply) + " and result " + std::to_string(r.result)
+                       + ", expected " + std::to_string(i) + " and " + std::to_string(records[0].result));
+            return;
+        }
+
+        Move list[MAX_MOVES], *end = pos.get_moves(list), *m = list;
+
+        // The moved piece leaves its square empty and occupies the target square
+        for (; m != end; m++)
+            if (   !(r.occupied & square_bb(m->from_sq()))
+                &&  (r.occupied & square_bb(m->to_sq())))
+            {
+                Position next = pos;
+                next.do_move(*m);
+
+                if (same_position(pack(next, 0, 0), r))
+                {
+                    pos = next;
+                    break;
+                }
+            }
+
+        if (m == end)
+        {
+            ctx.mismatch("record " + std::to_string(i) + " (" + unpack(r) + ") does not follow from " + pos.fen());
+            return;
+        }
+
+        if (GameState state = pos.game_state(); state != ONGOING)
+        {
+            ctx.mismatch("record " + std::to_string(i) + " after " + expected_termination(state, pos) + " (" + pos.fen() + ")");
+            return;
+        }
+    }
+
+    Move list[MAX_MOVES], *end = pos.get_moves(list);
+
+    for (Move *m = list; m != end; m++)
+    {
+        Position next = pos;
+        next.do_move(*m);
+
+        GameState state = next.game_state();
+
+        if (state != ONGOING && records[0].result == (state != MATE ? DRAW_RESULT : next.white_to_move() ? BLACK_WIN : WHITE_WIN))
+            return;
+    }
+
+    ctx.mismatch("result " + std::to_string(records[0].result) + " cannot be reached from the last record (" + pos.fen() + ")");
+}
+
+// Reads a chunk and the rest of the game that starts last in it. Returns the offsets in 'buf'
+// of the games that start in the chunk, followed by the end of the last one
+std::vector<size_t> read_games(const Archive& a, const Chunk& c, std::string& buf, uint64_t& base)
+{
+    std::ifstream in(a.path, std::ios::binary);
+
+    // The line before the chunk tells whether its first line starts a game
+    base = a.format == DATA_FILE ? c.begin : c.begin - std::min<uint64_t>(c.begin, 4096);
+    in.seekg(base);
+
+    auto have = [&](size_t n) {
+        while (buf.size() < n)
+        {
+            size_t size = buf.size();
+
+            buf.resize(size + (1 << 16));
+            in.read(buf.data() + size, 1 << 16);
+            buf.resize(size + in.gcount());
+
+            if (!in.gcount())
+                return false;
+        }
+
+        return true;
+    };
+
+    auto is_tag = [&](size_t begin, size_t end) {
+        std::string_view line(buf.data() + begin, end - begin);
+
+        while (!line.empty() && (line.back() == '\n' || line.back() == '\r'))
+            line.remove_suffix(1);
+
+        return line.size() > 4 && line[0] == '[' && isalpha(line[1]) && line.substr(line.size() - 2) == "\"]";
+    };
+
+    // For PGN, a tag that does not follow another tag. Comments may start lines with '[' too
+    auto starts_game = [&](size_t i, size_t end) {
+        if (a.format == LOG_FILE)
+            return buf.compare(i, 13, "position fen ") == 0;
+
+        size_t prev = i >= 2 ? buf.rfind('\n', i - 2) : std::string::npos;
+        prev = prev == std::string::npos ? 0 : prev + 1;
+
+        // A previous line that starts before the buffer is longer than any tag
+        return is_tag(i, end) && !((prev || !base) && is_tag(prev, i));
+    };
+
+    std::vector<size_t> games;
+    size_t i     = c.begin - base;
+    size_t limit = c.end - base;
+
+    buf.clear();
+    have(limit);
+
+    if (a.format == DATA_FILE)
+    {
+        for (PackedPos p; have(i + sizeof(PackedPos)); i += sizeof(PackedPos))
+        {
+            memcpy(&p, buf.data() + i, sizeof(PackedPos));
+
+            if (p.ply == 0 && i >= limit)
+                break;
+
+            if (p.ply == 0)
+                games.push_back(i);
+        }
+
+        i = std::min(i, buf.size() / sizeof(PackedPos) * sizeof(PackedPos));
+    }
+    else
+    {
+        auto next_line = [&](size_t i) {
+            for (size_t nl; have(i + 1); i = buf.size())
+                if ((nl = buf.find('\n', i)) != std::string::npos)
+                    return nl + 1;
+
+            return buf.size();
+        };
+
+        if (i > 0 && buf[i - 1] != '\n')
+            i = next_line(i);
+
+        for (size_t next; i < buf.size() || have(i + 1); i = next)
+        {
+            if (!starts_game(i, next = next_line(i)))
+                continue;
+
+            if (i >= limit)
+                break;
+
+            games.push_back(i);
+        }
+
+        i = std::min(i, buf.size());
+    }
+
+    if (!games.empty())
+        games.push_back(i);
+
+    return games;
+}
+
+}
+
+uint64_t run_verify(const std::vector<std::string>& paths, int threads, Control *control)
+{
+    build_slider_tables();
+
+    std::vector<Archive> archives;
+
+    auto add = [&](const std::filesystem::path& path) {
+        std::string ext = path.extension().string();
+        archives.push_back({ path.string(), ext == ".pgn" ? PGN_FILE : ext == ".bin" ? DATA_FILE : LOG_FILE, std::filesystem::file_size(path) });
+    };
+
+    for (const std::string& path : paths)
+    {
+        std::error_code ec;
+
+        if (std::filesystem::is_directory(path, ec))
+        {
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(path, ec))
+                if (std::string ext = entry.path().extension().string(); entry.is_regular_file() && (ext == ".txt" || ext == ".log" || ext == ".pgn" || ext == ".bin"))
+                    add(entry.path());
+        }
+        else if (std::filesystem::is_regular_file(path, ec))
+            add(path);
+        else
+            std::cout << "Could not read " << path << std::endl;
+    }
+
+    ChunkQueues queues(threads);
+    Totals      totals;
+    uint64_t    total_bytes = 0;
+
+    for (int a = 0, n = 0; a < archives.size(); a++)
+    {
+        for (uint64_t begin = 0; begin < archives[a].size; begin += ChunkSize)
+            queues.push(n++ % threads, { a, begin, std::min(archives[a].size, begin + ChunkSize) });
+
+        total_bytes += archives[a].size;
+    }
+
+    printf("Verifying %zu files, %.1f MB with %d threads\n", archives.size(), total_bytes / 1048576.0, threads);
+
+    auto start = std::chrono::steady_clock::now();
+
+    auto progress = [&]() {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        printf("%.1f/%.1f MB, %llu games, %llu moves in %.2f s, %.0f games/s, %llu mismatches\n",
+               totals.bytes / 1048576.0, total_bytes / 1048576.0, (unsigned long long)totals.games, (unsigned long long)totals.moves,
+               seconds, totals.games / seconds, (unsigned long long)totals.mismatches);
+    };
+
+    control->set_stats(progress);
+
+    std::vector<std::thread> thread_pool;
+
+    for (int id = 0; id < threads; id++)
+        thread_pool.emplace_back([&, id]() {
+            std::string buf;
+            uint64_t    base;
+
+            for (Chunk c; control->next_game(id) && queues.next(id, c);)
+            {
+                const Archive& a = archives[c.archive];
+                Context ctx = { a, totals, 0 };
+
+                std::vector<size_t> games = read_games(a, c, buf, base);
+
+                for (size_t g = 0; g + 1 < games.size(); g++)
+                {
+                    std::string_view game(buf.data() + games[g], games[g + 1] - games[g]);
+
+                    ctx.offset = base + games[g];
+
+                    if (a.format == LOG_FILE)
+                        verify_log_game(ctx, game);
+                    else if (a.format == PGN_FILE)
+                        verify_pgn_game(ctx, game);
+                    else
+                        verify_data_game(ctx, game);
+                }
+
+                totals.bytes += c.end - c.begin;
+            }
+        });
+
+    std::atomic<bool> done = false;
+
+    std::thread printer([&]() {
+        for (auto last = std::chrono::steady_clock::now(); !done; Sleep(100))
+            if (std::chrono::steady_clock::now() - last >= std::chrono::seconds(10))
+            {
+                progress();
+                last = std::chrono::steady_clock::now();
+            }
+    });
+
+    for (std::thread& thread : thread_pool)
+        thread.join();
+
+    control->set_stats(nullptr);
+
+    done = true;
+    printer.join();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("\n%llu games, %llu moves, %.1f MB in %.2f s with %d threads\n", (unsigned long long)totals.games, (unsigned long long)totals.moves,
+           totals.bytes / 1048576.0, seconds, threads);
+    printf("%.0f games/s, %.0f moves/s, %.1f MB/s\n", totals.games / seconds, totals.moves / seconds, totals.bytes / 1048576.0 / seconds);
+    printf("%llu unfinished games, %llu mismatches\n", (unsigned long long)totals.unfinished, (unsigned long long)totals.mismatches);
+
+    if (totals.mismatches > MaxReported)
+        printf("Only the first %llu mismatches are listed\n", (unsigned long long)MaxReported);
+
+    return totals.mismatches;
+}
@@ -0,0 +1,16 @@
+
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "control.h"
+
+// Replays stored games and reports every illegal move, result or termination that does not
+// match the moves. Paths are files or directories; *.pgn is read as PGN, *.bin as training
+// data from --datagen, anything else as a MatchManager game log. Returns the # of mismatches
+uint64_t run_verify(const std::vector<std::string>& paths, int threads, Control *control);
+
+#endif
@@ -0,0 +1,70 @@
+
+#include "watchdog.h"
+
+#include "engine.h"
+
+Watchdog& watchdog()
+{
+    static Watchdog w;
+    return w;
+}
+
+Watchdog::~Watchdog()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        quit = true;
+    }
+
+    cv.notify_one();
+    thread.join();
+}
+
+void Watchdog::arm(Engine *engine, Clock::time_point deadline)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        deadlines[engine] = deadline;
+    }
+
+    cv.notify_one();
+}
+
+void Watchdog::disarm(Engine *engine)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    deadlines.erase(engine);
+}
+
+void Watchdog::loop()
+{
+    std::unique_lock<std::mutex> lock(mtx);
+
+    while (!quit)
+    {
+        if (deadlines.empty())
+        {
+            cv.wait(lock);
+            continue;
+        }
+
+        Clock::time_point next = Clock::time_point::max();
+
+        for (const auto& [engine, deadline] : deadlines)
+            next = std::min(next, deadline);
+
+        if (cv.wait_until(lock, next) != std::cv_status::timeout)
+            continue;
+
+        for (auto it = deadlines.begin(); it != deadlines.end();)
+        {
+            if (it->second <= Clock::now())
+            {
+                it->first->terminate();
+                it = deadlines.erase(it);
+            }
+            else
+                ++it;
+        }
+    }
+}
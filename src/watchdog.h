@@ -0,0 +1,38 @@
+
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+
+class Engine;
+
+// Single background thread that terminates any engine still thinking past its deadline.
+// The blocked read in Engine::best_move() then fails and the move is scored as a time loss
+class Watchdog
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    Watchdog() : quit(false), thread(&Watchdog::loop, this) {}
+   ~Watchdog();
+
+    void arm(Engine *engine, Clock::time_point deadline);
+    void disarm(Engine *engine);
+
+private:
+    void loop();
+
+    std::mutex                         mtx;
+    std::condition_variable            cv;
+    std::map<Engine*, Clock::time_point> deadlines;
+    bool                               quit;
+    std::thread                        thread;
+};
+
+Watchdog& watchdog();
+
+#endif
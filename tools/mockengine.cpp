@@ -0,0 +1,143 @@
+
+// Minimal UCI engine that answers every 'go' instantly with a legal move, used to
+// measure the overhead of MatchManager itself (see --bench)
+//
+// mockengine           random legal move, seeded from the clock
+// mockengine <seed>    random legal move, fixed seed
+// mockengine first     always the first legal move in generation order
+//
+// 'go perft <depth>' counts the leaf nodes below the current position instead, to
+// check and time move generation and Position::do_move
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include "../src/bitboard.h"
+#include "../src/position.h"
+#include "../src/uci.h"
+
+// The last ply is counted from the move list without playing it
+uint64_t perft(const Position& pos, int depth)
+{
+    Move list[MAX_MOVES], *end = pos.get_moves(list);
+
+    if (depth <= 1)
+        return end - list;
+
+    uint64_t nodes = 0;
+
+    for (Move *m = list; m != end; m++)
+    {
+        Position next = pos;
+        next.do_move(*m);
+        nodes += perft(next, depth - 1);
+    }
+
+    return nodes;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string mode = argc > 1 ? argv[1] : "";
+    std::mt19937_64 rng(mode.empty() || mode == "first" ? std::random_device()() : std::stoull(mode));
+
+    Position pos;
+    std::string line, token, last_fen;
+    int applied = 0;
+
+    std::ios::sync_with_stdio(false);
+
+    while (std::getline(std::cin, line))
+    {
+        std::istringstream is(line);
+        is >> token;
+
+        if (token == "uci")
+            std::cout << "id name mockengine\nid author MatchManager\nuciok\n" << std::flush;
+
+        else if (token == "isready")
+            std::cout << "readyok\n" << std::flush;
+
+        else if (token == "ucinewgame")
+            last_fen.clear();
+
+        else if (token == "position")
+        {
+            std::string fen, word;
+
+            is >> word;
+
+            if (word == "startpos")
+                fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+            else
+                while (is >> word && word != "moves")
+                    fen += word + " ";
+
+            if (word != "moves")
+                is >> word;
+
+            // MatchManager resends the whole game every ply, only play the moves we have not seen yet
+            if (fen != last_fen)
+            {
+                pos.set(fen);
+                last_fen = fen;
+                applied = 0;
+            }
+
+            for (int i = 0; is >> word; i++)
+                if (i >= applied)
+                {
+                    if (Move m = uci_to_move(word, pos); m != Move::null())
+                        pos.do_move(m);
+
+                    applied++;
+                }
+        }
+
+        else if (token == "go" && line.find("perft") != std::string::npos)
+        {
+            int depth = 1;
+            is >> token >> depth;
+
+            auto start = std::chrono::steady_clock::now();
+
+            Move list[MAX_MOVES], *end = pos.get_moves(list);
+            uint64_t nodes = 0;
+
+            for (Move *m = list; m != end; m++)
+            {
+                Position next = pos;
+                next.do_move(*m);
+
+                uint64_t n = depth > 1 ? perft(next, depth - 1) : 1;
+                std::cout << move_to_uci(*m) << ": " << n << "\n";
+                nodes += n;
+            }
+
+            auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+            std::cout << "\nNodes searched: " << nodes << "\nTime: " << ms << " ms, " << nodes / std::max<int64_t>(1, ms) << " knps\n" << std::flush;
+        }
+
+        else if (token == "go")
+        {
+            Move list[MAX_MOVES], *end = pos.get_moves(list);
+
+            if (list == end)
+                std::cout << "info depth 0 score cp 0\nbestmove 0000\n" << std::flush;
+            else
+            {
+                Move m = mode == "first" ? list[0] : list[rng() % (end - list)];
+                std::cout << "info depth 1 nodes " << end - list << " score cp 0\nbestmove " << move_to_uci(m) << "\n" << std::flush;
+            }
+        }
+
+        else if (token == "quit")
+            break;
+    }
+}